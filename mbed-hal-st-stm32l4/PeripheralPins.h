@@ -55,6 +55,10 @@ extern const PinMap PinMap_PWM[];
 
 extern const PinMap PinMap_UART_TX[];
 extern const PinMap PinMap_UART_RX[];
+extern const PinMap PinMap_UART_RTS[];
+extern const PinMap PinMap_UART_CTS[];
+// optional, empty unless the target defines it (USART synchronous mode as SPI master)
+extern const PinMap PinMap_USART_CK[];
 
 //*** SPI ***
 
@@ -63,4 +67,15 @@ extern const PinMap PinMap_SPI_MISO[];
 extern const PinMap PinMap_SPI_SCLK[];
 extern const PinMap PinMap_SPI_SSEL[];
 
+//*** QUADSPI ***
+
+// weak defaults with the STM32L476 pins of ports A and B, a target can define its own
+
+extern const PinMap PinMap_QSPI_IO0[];
+extern const PinMap PinMap_QSPI_IO1[];
+extern const PinMap PinMap_QSPI_IO2[];
+extern const PinMap PinMap_QSPI_IO3[];
+extern const PinMap PinMap_QSPI_CLK[];
+extern const PinMap PinMap_QSPI_CS[];
+
 #endif
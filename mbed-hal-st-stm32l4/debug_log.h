@@ -0,0 +1,84 @@
+/* mbed Microcontroller Library
+ *******************************************************************************
+ * Copyright (c) 2015, STMicroelectronics
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of STMicroelectronics nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************
+ */
+#ifndef MBED_DEBUG_LOG_H
+#define MBED_DEBUG_LOG_H
+
+#include "serial_api.h"
+
+#if DEVICE_SERIAL
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Longest record debug_log_write() queues and debug_log_printf() formats,
+// longer ones are truncated
+#define DEBUG_LOG_RECORD_MAX (96)
+
+/** Send the debug records to a UART
+ *
+ * The UART is switched to the buffered mode with buffer as its TX ring, its
+ * interrupt drains the records in the background. Records written before
+ * debug_log_init() are dropped.
+ *
+ * @param size size of buffer in bytes, a power of two
+ * @return 0 on success, -1 on an invalid size
+ */
+int debug_log_init(serial_t *obj, void *buffer, size_t size);
+
+/** Queue a record, from thread or interrupt context
+ *
+ * Never blocks nor waits for the UART: the record is copied whole into the ring
+ * with interrupts masked for the copy only, or dropped and counted when the ring
+ * is full. Records are truncated to DEBUG_LOG_RECORD_MAX bytes, which bounds the
+ * time interrupts stay masked to a copy of that many bytes.
+ */
+void debug_log_write(const void *data, size_t length);
+
+/** Format a record of at most DEBUG_LOG_RECORD_MAX bytes and queue it
+ *
+ * vsnprintf() runs in the context of the caller, with interrupts enabled, on a
+ * DEBUG_LOG_RECORD_MAX byte buffer on its stack: its time depends on the format
+ * and the arguments, so a call from an interrupt handler is not constant time.
+ * Use debug_log_write() with a preformatted record where that matters.
+ */
+void debug_log_printf(const char *format, ...);
+
+/** Number of records dropped because the ring was full or not set up
+ */
+uint32_t debug_log_dropped(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DEVICE_SERIAL
+
+#endif
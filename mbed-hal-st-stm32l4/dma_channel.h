@@ -0,0 +1,120 @@
+/* mbed Microcontroller Library
+ *******************************************************************************
+ * Copyright (c) 2015, STMicroelectronics
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of STMicroelectronics nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************
+ */
+#ifndef MBED_DMA_CHANNEL_H
+#define MBED_DMA_CHANNEL_H
+
+#include "cmsis.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Channel numbers start at 1 so that a zeroed object owns no channel
+#define DMA_CHANNEL_NONE (0)
+
+// Number of channels (DMA1 channels 1..7, then DMA2 channels 1..7)
+#define DMA_CHANNEL_NUM  (14)
+
+// Channel status flags, normalized to the channel 1 bit positions
+#define DMA_CHANNEL_FLAG_GI (DMA_ISR_GIF1)
+#define DMA_CHANNEL_FLAG_TC (DMA_ISR_TCIF1)
+#define DMA_CHANNEL_FLAG_HT (DMA_ISR_HTIF1)
+#define DMA_CHANNEL_FLAG_TE (DMA_ISR_TEIF1)
+
+// Peripheral requests that can be routed to a DMA channel through CSELR
+typedef enum {
+    DMA_REQ_USART1_TX = 0,
+    DMA_REQ_USART1_RX,
+    DMA_REQ_USART2_TX,
+    DMA_REQ_USART2_RX,
+    DMA_REQ_USART3_TX,
+    DMA_REQ_USART3_RX,
+    DMA_REQ_UART4_TX,
+    DMA_REQ_UART4_RX,
+    DMA_REQ_UART5_TX,
+    DMA_REQ_UART5_RX,
+    DMA_REQ_LPUART1_TX,
+    DMA_REQ_LPUART1_RX,
+    DMA_REQ_SPI1_TX,
+    DMA_REQ_SPI1_RX,
+    DMA_REQ_SPI2_TX,
+    DMA_REQ_SPI2_RX,
+    DMA_REQ_SPI3_TX,
+    DMA_REQ_SPI3_RX,
+    DMA_REQ_I2C1_TX,
+    DMA_REQ_I2C1_RX,
+    DMA_REQ_I2C2_TX,
+    DMA_REQ_I2C2_RX,
+    DMA_REQ_I2C3_TX,
+    DMA_REQ_I2C3_RX,
+    DMA_REQ_QUADSPI,
+    DMA_REQ_NUM
+} DMARequestName;
+
+/** Claim a free channel able to serve the request and route the request to it
+ *
+ * @return the channel number, or DMA_CHANNEL_NONE if every candidate channel is in use
+ */
+int dma_channel_claim(DMARequestName request);
+
+/** Stop the channel and give it back to the pool
+ */
+void dma_channel_release(int channel);
+
+DMA_Channel_TypeDef *dma_channel_instance(int channel);
+
+IRQn_Type dma_channel_irq(int channel);
+
+/** Program and enable the channel
+ *
+ * @param ccr    CCR configuration (direction, sizes, increments, interrupts), EN is added here
+ * @param periph peripheral data register
+ * @param mem    memory buffer
+ * @param count  number of data items
+ */
+void dma_channel_start(int channel, uint32_t ccr, volatile void *periph, const void *mem, uint16_t count);
+
+/** Disable the channel and clear its pending flags
+ */
+void dma_channel_stop(int channel);
+
+/** Number of data items still to be transferred
+ */
+uint16_t dma_channel_remaining(int channel);
+
+uint32_t dma_channel_flags(int channel);
+
+void dma_channel_clear(int channel, uint32_t flags);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,152 @@
+/* mbed Microcontroller Library
+ *******************************************************************************
+ * Copyright (c) 2015, STMicroelectronics
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of STMicroelectronics nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************
+ */
+#ifndef MBED_QSPI_API_H
+#define MBED_QSPI_API_H
+
+#include "cmsis.h"
+#include "PinNames.h"
+#include "dma_api.h"
+
+#if defined(QUADSPI)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define QSPI_EVENT_ERROR    (1 << 1)
+#define QSPI_EVENT_COMPLETE (1 << 2)
+#define QSPI_EVENT_MATCH    (1 << 3)
+#define QSPI_EVENT_ALL      (QSPI_EVENT_ERROR | QSPI_EVENT_COMPLETE | QSPI_EVENT_MATCH)
+
+// Lines a phase runs on, NONE skips the phase
+typedef enum {
+    QSPI_LINES_NONE = 0,
+    QSPI_LINES_1    = 1,
+    QSPI_LINES_2    = 2,
+    QSPI_LINES_4    = 3,
+} qspi_lines_t;
+
+// Phases of a flash command, as the controller clocks them
+typedef struct {
+    uint8_t instruction;
+    qspi_lines_t instruction_lines;
+    uint32_t address;
+    qspi_lines_t address_lines;
+    uint8_t address_bytes;              // 1 to 4
+    uint32_t alternate;                 // mode bits of the continuous read commands
+    qspi_lines_t alternate_lines;
+    uint8_t alternate_bytes;            // 1 to 4
+    uint8_t dummy_cycles;               // 0 to 31
+    qspi_lines_t data_lines;
+} qspi_command_t;
+
+/** Set up the QUADSPI controller and its pins
+ *
+ * io2 and io3 may be NC for flashes wired for 1 or 2 lines only.
+ *
+ * @param flash_size size of the flash in bytes, a power of two
+ * @return 0 on success, -1 if the pins do not belong to the QUADSPI
+ */
+int qspi_init(PinName io0, PinName io1, PinName io2, PinName io3, PinName sclk, PinName ssel, uint32_t flash_size);
+
+void qspi_free(void);
+
+/** Pick the fastest clock of HCLK / 1 to 256 not above hz
+ *
+ * @return the actual frequency
+ */
+int qspi_frequency(int hz);
+
+/** Run a command without data phase, such as write enable or erase
+ *
+ * @return 0 on success, -1 on a transfer error
+ */
+int qspi_command(const qspi_command_t *command);
+
+/** Polled indirect transfers
+ *
+ * @return the number of bytes transferred, -1 on a transfer error
+ */
+int qspi_read(const qspi_command_t *command, void *data, size_t length);
+int qspi_write(const qspi_command_t *command, const void *data, size_t length);
+
+/** Indirect transfers in the background, on a DMA channel or else from the FIFO threshold interrupt
+ *
+ * The handler is called with the QUADSPI and DMA interrupts; it must call
+ * qspi_irq_handler_asynch(), which returns QSPI_EVENT_COMPLETE or
+ * QSPI_EVENT_ERROR once the transfer is over.
+ *
+ * @return 0 on success, -1 if the controller is busy
+ */
+int qspi_read_asynch(const qspi_command_t *command, void *data, size_t length, uint32_t handler, DMAUsage hint);
+int qspi_write_asynch(const qspi_command_t *command, const void *data, size_t length, uint32_t handler, DMAUsage hint);
+
+/** Run the command until (status & mask) == match, in hardware
+ *
+ * The controller reads the status with the command every interval clocks, the
+ * CPU is not involved until the match.
+ *
+ * @param bytes status size, 1 to 4
+ * @return 0 on match, -1 on a transfer error
+ */
+int qspi_poll(const qspi_command_t *command, uint32_t mask, uint32_t match, size_t bytes, uint16_t interval);
+
+/** As qspi_poll(), the match ends with QSPI_EVENT_MATCH from qspi_irq_handler_asynch()
+ *
+ * @return 0 on success, -1 if the controller is busy
+ */
+int qspi_poll_asynch(const qspi_command_t *command, uint32_t mask, uint32_t match, size_t bytes, uint16_t interval, uint32_t handler);
+
+uint32_t qspi_irq_handler_asynch(void);
+
+uint8_t qspi_active(void);
+
+/** Stop the running transfer or poll
+ */
+void qspi_abort_asynch(void);
+
+/** Map the flash at QSPI_BASE, each read running the command
+ *
+ * The data lines, dummy cycles and alternate bytes of the command apply, the
+ * address is the offset of the access. The other functions unmap the flash first.
+ *
+ * @return the address of the flash in the memory map
+ */
+const void *qspi_memory_map(const qspi_command_t *command);
+
+void qspi_memory_unmap(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // QUADSPI
+
+#endif
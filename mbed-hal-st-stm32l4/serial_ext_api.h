@@ -0,0 +1,231 @@
+/* mbed Microcontroller Library
+ *******************************************************************************
+ * Copyright (c) 2015, STMicroelectronics
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of STMicroelectronics nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************
+ */
+#ifndef MBED_SERIAL_EXT_API_H
+#define MBED_SERIAL_EXT_API_H
+
+#include "serial_api.h"
+
+#if DEVICE_SERIAL
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// STM32L4 specific events, outside of SERIAL_EVENT_TX_MASK and SERIAL_EVENT_RX_MASK
+#define SERIAL_EVENT_RX_HALF_FULL (1 << 16) // circular reception: first half of the buffer written
+#define SERIAL_EVENT_RX_FULL      (1 << 17) // circular reception: second half written, wrapping around
+#define SERIAL_EVENT_RX_IDLE      (1 << 18) // circular reception: the line went idle after a frame
+#define SERIAL_EVENT_RX_TIMEOUT   (1 << 19) // receiver timeout: the frame ended, see serial_rx_timeout()
+
+// Kernel clock of a UART, selected in RCC_CCIPR
+typedef enum {
+    SerialClockPCLK   = 0,  // APB clock (default), stopped in STOP modes
+    SerialClockSYSCLK = 1,
+    SerialClockHSI    = 2,  // HSI16, can be requested by the UART in STOP modes
+    SerialClockLSE    = 3,  // 32.768 kHz LSE, up to 9600 baud, always running
+} SerialClockSource;
+
+// Event waking the MCU up from STOP (CR3.WUS)
+typedef enum {
+    SerialWakeupAddress  = 0,  // address match, see ADD in CR2
+    SerialWakeupStartBit = 2,  // start bit detection
+    SerialWakeupRxne     = 3,  // a complete character received
+} SerialWakeup;
+
+/** Select the kernel clock of the UART
+ *
+ * The oscillator is started if needed and the baud rate is recomputed for the new clock.
+ *
+ * @return 0 on success, -1 if the oscillator does not start
+ */
+int serial_clock_source(serial_t *obj, SerialClockSource source);
+
+/** Baud rate the UART actually runs at
+ *
+ * serial_baud() computes BRR from the kernel clock of the instance (PCLK2 for
+ * USART1, PCLK1 for the others, unless changed by serial_clock_source()) and
+ * switches to 8x oversampling when 16x cannot reach the rate, up to fck / 8.
+ * It fails with error() below fck / 65535 (1221 baud at 80 MHz), where BRR
+ * overflows, and when the rate is off by more than 2.5%.
+ */
+int serial_baud_actual(serial_t *obj);
+
+/** Error of the programmed baud rate against the one requested with serial_baud()
+ *
+ * serial_baud() and serial_format() only rewrite the BRR/CR1/CR2 fields that
+ * changed, keeping pending asynchronous transfers, so they can be called often.
+ *
+ * @return the error in ppm, positive when the UART runs faster than requested
+ */
+int32_t serial_baud_error(serial_t *obj);
+
+/** Let the UART wake the MCU up from STOP
+ *
+ * The UART must be clocked from HSI or LSE, see serial_clock_source(). Only
+ * LPUART1 keeps working in STOP2, the other UARTs down to STOP1.
+ *
+ * @return 0 on success, -1 if the UART is clocked from PCLK or SYSCLK
+ */
+int serial_wakeup_from_stop(serial_t *obj, SerialWakeup wakeup, int enable);
+
+/** Start a never ending DMA reception into a ring buffer
+ *
+ * The DMA channel writes into rx and wraps around at rx_length. The handler is
+ * invoked on half/full buffer and when the line goes idle; serial_irq_handler_asynch()
+ * then reports SERIAL_EVENT_RX_HALF_FULL, SERIAL_EVENT_RX_FULL and SERIAL_EVENT_RX_IDLE
+ * together with the usual error events. The reception runs until serial_rx_abort_asynch().
+ *
+ * @param rx_length number of rx_width sized items in rx (at most 65535)
+ * @return 0 on success, -1 if no DMA channel is available
+ */
+int serial_rx_circular_asynch(serial_t *obj, void *rx, size_t rx_length, uint8_t rx_width, uint32_t handler, uint32_t event);
+
+/** Index in the ring buffer of the next item the DMA channel will write
+ */
+size_t serial_rx_circular_index(serial_t *obj);
+
+/** Segment of a scatter-gather transmission
+ */
+typedef struct {
+    const void *buffer;
+    size_t length;      // in tx_width sized items, at most 65535
+} serial_iovec_t;
+
+/** Send a list of segments back to back, without copying them together
+ *
+ * Lists sent while a previous one is still going out are queued (up to 4, each
+ * list stays owned by the UART until the end) and follow it without idle time
+ * on the line. The handler gets a single SERIAL_EVENT_TX_COMPLETE, once the last
+ * queued list has left the shift register; tx_buff.pos counts the items sent
+ * across all queued lists. The DMA channel, if any, is reprogrammed from its
+ * interrupt for every segment.
+ *
+ * @return the number of items queued, 0 if the queue is full or a segment too long
+ */
+int serial_tx_vector_asynch(serial_t *obj, const serial_iovec_t *iov, size_t iovcnt, uint8_t tx_width, uint32_t handler, uint32_t event, DMAUsage hint);
+
+/** Set the receiver timeout of the following serial_rx_asynch() receptions
+ *
+ * Once a character has been received, a silence of bit_times bit durations on
+ * the line ends the reception in hardware (RTOR/RTOEN). The handler then gets
+ * SERIAL_EVENT_RX_TIMEOUT together with SERIAL_EVENT_RX_COMPLETE, each if it is
+ * part of the event mask of serial_rx_asynch(), and rx_buff.pos holds the
+ * received length. 0 disables the timeout.
+ *
+ * @param bit_times timeout in bit durations, at most 0xFFFFFF
+ * @return 0 on success, -1 if the UART has no receiver timeout (LPUART1)
+ */
+int serial_rx_timeout(serial_t *obj, uint32_t bit_times);
+
+/** Switch the UART to the buffered mode
+ *
+ * The UART interrupt moves data between the data registers and two single
+ * producer/single consumer rings, without calling the handler registered with
+ * serial_irq_handler(). Either ring can be omitted (NULL, 0).
+ *
+ * @param rx_size size of rx_buffer in bytes, a power of two
+ * @param tx_size size of tx_buffer in bytes, a power of two
+ * @return 0 on success, -1 on invalid sizes
+ */
+int serial_buffered_enable(serial_t *obj, void *rx_buffer, size_t rx_size, void *tx_buffer, size_t tx_size);
+
+/** Leave the buffered mode, data still in the rings is dropped
+ */
+void serial_buffered_disable(serial_t *obj);
+
+/** Copy up to length received bytes out of the RX ring, never blocks
+ *
+ * @return the number of bytes copied
+ */
+size_t serial_read(serial_t *obj, void *buffer, size_t length);
+
+/** Queue up to length bytes into the TX ring, never blocks
+ *
+ * @return the number of bytes queued
+ */
+size_t serial_write(serial_t *obj, const void *buffer, size_t length);
+
+/** Number of bytes serial_write() can queue right now
+ */
+size_t serial_write_space(serial_t *obj);
+
+/** Number of received bytes dropped because the RX ring was full
+ */
+uint32_t serial_rx_dropped(serial_t *obj);
+
+#if DEVICE_SERIAL_FC
+/** Drive an RS-485 transceiver from the DE output of the UART
+ *
+ * The UART asserts DE before the start bit and releases it after the last stop
+ * bit, without software turnaround. DE replaces RTS, hardware RTS flow control
+ * is turned off. Needs the flow control pin maps (DEVICE_SERIAL_FC).
+ *
+ * @param de the RTS pin of the UART
+ * @param active_low DE polarity
+ * @param assertion DE assertion to start bit delay, in 1/16 (OVER8: 1/8) bit times, at most 31
+ * @param deassertion end of stop bit to DE deassertion delay, same unit
+ * @return 0 on success, -1 on a pin or timing the UART cannot use
+ */
+int serial_rs485_enable(serial_t *obj, PinName de, int active_low, uint8_t assertion, uint8_t deassertion);
+
+/** Stop driving DE
+ */
+void serial_rs485_disable(serial_t *obj);
+#endif
+
+/** Mute the receiver until a frame addressed to this node starts
+ *
+ * Address mark wakeup: characters with their MSB set are addresses. The receiver
+ * stays mute, without RXNE nor interrupts, until an address matching the
+ * address_bits LSBs of address is received; this address character is received
+ * and so is every character up to the next non matching address, which mutes the
+ * receiver again. The character match of serial_rx_asynch() is not available
+ * while the mute mode is enabled, both use CR2.ADD.
+ *
+ * @param address_bits 4 or 7
+ * @return 0 on success, -1 on invalid address_bits
+ */
+int serial_mute_enable(serial_t *obj, uint8_t address, uint8_t address_bits);
+
+/** Mute the receiver now, until our address is received again
+ */
+void serial_mute_enter(serial_t *obj);
+
+/** Leave the mute mode, all characters are received
+ */
+void serial_mute_disable(serial_t *obj);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DEVICE_SERIAL
+
+#endif
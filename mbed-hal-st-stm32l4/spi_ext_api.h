@@ -0,0 +1,197 @@
+/* mbed Microcontroller Library
+ *******************************************************************************
+ * Copyright (c) 2015, STMicroelectronics
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of STMicroelectronics nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************
+ */
+#ifndef MBED_SPI_EXT_API_H
+#define MBED_SPI_EXT_API_H
+
+#include "spi_api.h"
+#include "gpio_object.h"
+
+#if DEVICE_SPI
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bus settings of a device, applied by the transaction queue when they change
+typedef struct {
+    int bits;
+    int mode;
+    spi_bitorder_t order;
+    int hz;
+    uint32_t cr1;                       // register images from spi_profile_prepare(), 0 if none
+    uint32_t cr2;
+} spi_profile_t;
+
+// The CRC received at the end of a transfer did not match, reported with SPI_EVENT_ERROR
+#define SPI_EVENT_CRC_ERROR (1 << 4)
+
+typedef struct spi_transaction spi_transaction_t;
+
+/** Called from the interrupt once the transaction is over, the next one already runs
+ *
+ * @param event SPI_EVENT_COMPLETE, or SPI_EVENT_ERROR with SPI_EVENT_RX_OVERFLOW or SPI_EVENT_CRC_ERROR
+ */
+typedef void (*spi_transaction_callback_t)(spi_transaction_t *transaction, int event);
+
+struct spi_transaction {
+    gpio_t *cs;                         // active low chip select output, NULL if none
+    const spi_profile_t *profile;       // NULL keeps the current bus settings
+    const void *tx;
+    size_t tx_length;                   // in bytes, as spi_master_transfer()
+    void *rx;
+    size_t rx_length;
+    spi_transaction_callback_t callback;
+    void *context;                      // free for the caller
+    spi_transaction_t *next;            // used by the queue
+};
+
+/** Queue a transaction on the bus
+ *
+ * The transactions run back to back from the SPI/DMA interrupts: the interrupt
+ * ending one releases its chip select, starts the next one and only then calls
+ * the callback. The transaction must stay valid until its callback. The bus must
+ * not be used with the other asynchronous functions meanwhile.
+ *
+ * @return 0 on success, -1 on an empty transaction or a synchronous USART bus
+ */
+int spi_transaction_queue(spi_t *obj, spi_transaction_t *transaction, DMAUsage hint);
+
+/** Precompute the register images of a profile for this bus
+ *
+ * The queue then switches to the profile with a couple of register writes
+ * instead of going through spi_format() and spi_frequency(). The images hold the
+ * bus clock, the chip select and the CRC mode of the moment: prepare again after
+ * changing the system clock or calling spi_transaction_hardware_cs(),
+ * spi_transaction_software_cs(), spi_crc_enable() or spi_crc_disable().
+ *
+ * @return 0 on success, -1 on frames the enabled CRC does not run on or a synchronous USART bus
+ */
+int spi_profile_prepare(spi_t *obj, spi_profile_t *profile);
+
+/** Let the SPI drive its NSS pin as chip select of the queued transactions
+ *
+ * NSS is asserted for the duration of each transaction; with pulse, it is also
+ * released for one SCK period between frames (NSSP, CPHA = 0 modes only). The
+ * transactions cs is ignored then.
+ *
+ * The SPI is only enabled while it clocks, so the other master calls assert NSS
+ * as well: spi_master_write() for its one frame, spi_master_block_write() and
+ * spi_master_transfer() for the whole buffer.
+ *
+ * The setting lasts until spi_transaction_software_cs() or spi_free().
+ *
+ * @return 0 on success, -1 if ssel is not the NSS pin of the SPI
+ */
+int spi_transaction_hardware_cs(spi_t *obj, PinName ssel, int pulse);
+
+/** Stop driving the NSS pin, back to the cs GPIOs of the transactions
+ *
+ * The NSS pin is left as an input. Call with no transaction queued.
+ *
+ * @return 0 on success, -1 while transactions are queued or on a synchronous USART bus
+ */
+int spi_transaction_software_cs(spi_t *obj);
+
+/** Let the SPI CRC unit protect every transfer
+ *
+ * spi_master_transfer() and spi_master_block_write() then clock out the CRC of
+ * the TX frames after the last one, and clock in the CRC of the device in the
+ * same place: a mismatch ends the transfer with SPI_EVENT_CRC_ERROR (pass it in
+ * the event mask), or makes spi_master_block_write() return -1. The CRC frames
+ * are not part of the buffers. The CRC unit only runs on 8 and 16 bit frames,
+ * and a 16 bit CRC takes two frames of 8 bits. DMA transfers with a CRC must fit
+ * in a single chunk: equal lengths or a single buffer, up to 65535 frames;
+ * others run from the SPI interrupt.
+ *
+ * While the CRC is enabled, spi_format() only accepts the frame sizes it runs
+ * on, and spi_profile_prepare() fails on the others.
+ *
+ * @param polynomial generator polynomial without its top bit, odd (0x07 for x^8 + x^2 + x + 1)
+ * @param bits CRC size, 8 or 16; 8 bit CRCs only with 8 bit frames
+ * @return 0 on success, -1 on bad parameters, frames of another size than 8 or
+ *         16 bits, or a synchronous USART bus
+ */
+int spi_crc_enable(spi_t *obj, uint16_t polynomial, int bits);
+
+void spi_crc_disable(spi_t *obj);
+
+/** SCK frequency the bus actually runs at
+ *
+ * spi_frequency() picks the fastest prescaler of the bus clock of the instance
+ * (APB2 for SPI1, APB1 for SPI2 and SPI3) that does not exceed the request, or
+ * the slowest one if none does.
+ */
+int spi_frequency_actual(spi_t *obj);
+
+/** Polled transfer of a whole block
+ *
+ * Frames of 4 to 8 bits are packed two per 16-bit FIFO access, frames of 9 to
+ * 16 bits take a little endian half-word each. Lengths are in bytes; the longer
+ * buffer sets the transfer length, write_fill is clocked out past the end of the
+ * TX buffer and the frames past the end of the RX buffer are dropped. With 9 to
+ * 16 bit frames, an odd length ends with a frame whose high byte is write_fill.
+ *
+ * @return the number of bytes clocked, -1 on a CRC mismatch
+ */
+int spi_master_block_write(spi_t *obj, const char *tx_buffer, int tx_length, char *rx_buffer, int rx_length, char write_fill);
+
+#if DEVICE_SPISLAVE
+/** Turn the bus into a slave framed by the NSS pin of the master
+ *
+ * Call after spi_init() and spi_format(). spi_slave_read(), spi_slave_write()
+ * and spi_slave_transfer() then work on the bus; the master functions and the
+ * transaction queue do not.
+ *
+ * @return 0 on success, -1 if ssel is not the NSS pin of the SPI or on a synchronous USART bus
+ */
+int spi_slave_init(spi_t *obj, PinName ssel);
+
+/** Arm a slave transfer on the DMA channels, while NSS is high
+ *
+ * The TX FIFO is loaded with the first frames of the reply before the master
+ * starts, so they go out from its first clock. Past the end of the TX buffer the
+ * fill word is clocked out, past the end of the RX buffer the frames are dropped.
+ * The rising edge of NSS ends the transfer with SPI_EVENT_COMPLETE, through the
+ * handler like any asynch transfer; rx_buff.pos and tx_buff.pos then hold the
+ * bytes the master clocked, up to the buffer lengths. spi_abort_asynch() disarms it.
+ *
+ * @return 0 on success, -1 if the bus is not a slave or busy, a buffer is over
+ *         65535 frames, or no DMA channel is available
+ */
+int spi_slave_transfer(spi_t *obj, const void *tx, size_t tx_length, void *rx, size_t rx_length, uint32_t handler, uint32_t event, DMAUsage hint);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DEVICE_SPI
+
+#endif
@@ -0,0 +1,183 @@
+/* mbed Microcontroller Library
+ *******************************************************************************
+ * Copyright (c) 2015, STMicroelectronics
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of STMicroelectronics nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************
+ */
+#ifndef MBED_UART_RING_H
+#define MBED_UART_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "cmsis.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Single producer/single consumer ring, indexes are free running.
+// The producer only writes head, the consumer only writes tail: one side can
+// run in an interrupt and the other in a thread without locking.
+typedef struct uart_ring {
+    uint8_t *buffer;
+    uint32_t mask;              // size - 1, the size is a power of two
+    volatile uint32_t head;     // written by the producer only
+    volatile uint32_t tail;     // written by the consumer only
+} uart_ring_t;
+
+/** Attach a buffer to the ring, a NULL buffer or size 0 leaves it without storage
+ *
+ * @return 0 on success, -1 if size is not a power of two
+ */
+static inline int uart_ring_init(uart_ring_t *ring, void *buffer, size_t size)
+{
+    if (buffer == NULL || size == 0) {
+        ring->buffer = NULL;
+        ring->mask = 0;
+    } else if (size & (size - 1)) {
+        return -1;
+    } else {
+        ring->buffer = (uint8_t *)buffer;
+        ring->mask = size - 1;
+    }
+    ring->head = 0;
+    ring->tail = 0;
+    return 0;
+}
+
+/** Bytes the producer can add */
+static inline uint32_t uart_ring_space(const uart_ring_t *ring)
+{
+    return ring->mask + 1 - (ring->head - ring->tail);
+}
+
+/** Add one byte (producer side)
+ *
+ * @return 1 if stored, 0 if the ring is full
+ */
+static inline int uart_ring_put(uart_ring_t *ring, uint8_t data)
+{
+    uint32_t head = ring->head;
+
+    if ((head - ring->tail) > ring->mask)
+        return 0;
+    ring->buffer[head & ring->mask] = data;
+    // publish the data before the index
+    __DMB();
+    ring->head = head + 1;
+    return 1;
+}
+
+/** Take one byte (consumer side)
+ *
+ * @return 1 if a byte was taken, 0 if the ring is empty
+ */
+static inline int uart_ring_get(uart_ring_t *ring, uint8_t *data)
+{
+    uint32_t tail = ring->tail;
+
+    if (tail == ring->head)
+        return 0;
+    // read the index before the data
+    __DMB();
+    *data = ring->buffer[tail & ring->mask];
+    // consume the data before releasing the slot
+    __DMB();
+    ring->tail = tail + 1;
+    return 1;
+}
+
+/** Add up to length bytes (producer side)
+ *
+ * @return the number of bytes stored
+ */
+static inline size_t uart_ring_write(uart_ring_t *ring, const void *buffer, size_t length)
+{
+    const uint8_t *data = (const uint8_t *)buffer;
+    uint32_t head = ring->head;
+    uint32_t space = ring->mask + 1 - (head - ring->tail);
+
+    if (length > space) {
+        length = space;
+    }
+    if (length == 0)
+        return 0;
+    // the slots are free only once the consumer is done reading them
+    __DMB();
+
+    // copy in at most two chunks, up to the end of the ring and from its start
+    uint32_t offset = head & ring->mask;
+    size_t first = ring->mask + 1 - offset;
+    if (first > length) {
+        first = length;
+    }
+    memcpy(&ring->buffer[offset], data, first);
+    memcpy(ring->buffer, data + first, length - first);
+
+    // publish the data before the index
+    __DMB();
+    ring->head = head + length;
+    return length;
+}
+
+/** Take up to length bytes (consumer side)
+ *
+ * @return the number of bytes taken
+ */
+static inline size_t uart_ring_read(uart_ring_t *ring, void *buffer, size_t length)
+{
+    uint8_t *data = (uint8_t *)buffer;
+    uint32_t tail = ring->tail;
+    uint32_t count = ring->head - tail;
+
+    if (length > count) {
+        length = count;
+    }
+    if (length == 0)
+        return 0;
+    // read the index before the data
+    __DMB();
+
+    uint32_t offset = tail & ring->mask;
+    size_t first = ring->mask + 1 - offset;
+    if (first > length) {
+        first = length;
+    }
+    memcpy(data, &ring->buffer[offset], first);
+    memcpy(data + first, ring->buffer, length - first);
+
+    // consume the data before releasing the slots
+    __DMB();
+    ring->tail = tail + length;
+    return length;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
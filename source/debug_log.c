@@ -0,0 +1,106 @@
+/* mbed Microcontroller Library
+ *******************************************************************************
+ * Copyright (c) 2015, STMicroelectronics
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of STMicroelectronics nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************
+ */
+#include "debug_log.h"
+
+#if DEVICE_SERIAL
+
+#include "cmsis.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include "serial_ext_api.h"
+
+static serial_t *debug_log_serial = NULL;
+static volatile uint32_t debug_log_drops = 0;
+
+int debug_log_init(serial_t *obj, void *buffer, size_t size)
+{
+    if (serial_buffered_enable(obj, NULL, 0, buffer, size) != 0)
+        return -1;
+
+    debug_log_serial = obj;
+
+    return 0;
+}
+
+void debug_log_write(const void *data, size_t length)
+{
+    // several producers, from thread and interrupt context: the record is copied
+    // whole into the ring, the UART interrupt takes it from there. The copy runs
+    // with interrupts masked, so it is kept short.
+    if (length > DEBUG_LOG_RECORD_MAX) {
+        length = DEBUG_LOG_RECORD_MAX;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if ((debug_log_serial == NULL) || (serial_write_space(debug_log_serial) < length)) {
+        debug_log_drops++;
+    } else {
+        serial_write(debug_log_serial, data, length);
+    }
+
+    __set_PRIMASK(primask);
+}
+
+void debug_log_printf(const char *format, ...)
+{
+    char record[DEBUG_LOG_RECORD_MAX];
+    va_list args;
+
+    if (debug_log_serial == NULL) {
+        // the counter is shared with the interrupts, updated in the critical section
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        debug_log_drops++;
+        __set_PRIMASK(primask);
+        return;
+    }
+
+    // formatted outside of the critical section
+    va_start(args, format);
+    int length = vsnprintf(record, sizeof(record), format, args);
+    va_end(args);
+
+    if (length < 0)
+        return;
+    if (length >= (int)sizeof(record)) {
+        length = sizeof(record) - 1;
+    }
+
+    debug_log_write(record, length);
+}
+
+uint32_t debug_log_dropped(void)
+{
+    return debug_log_drops;
+}
+
+#endif
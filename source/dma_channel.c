@@ -0,0 +1,211 @@
+/* mbed Microcontroller Library
+ *******************************************************************************
+ * Copyright (c) 2015, STMicroelectronics
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of STMicroelectronics nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************
+ */
+#include "mbed-drivers/mbed_assert.h"
+#include "dma_channel.h"
+
+#include <stddef.h>
+#include "cmsis.h"
+
+// Maximum number of channels a single request can be routed to
+#define DMA_ROUTE_NUM (2)
+
+typedef struct dma_channel_info {
+    DMA_TypeDef *dma;                 // controller (ISR/IFCR)
+    DMA_Channel_TypeDef *channel;     // channel registers
+    DMA_Request_TypeDef *cselr;       // request selection register of the controller
+    IRQn_Type irq;
+    uint8_t shift;                    // position of the channel in ISR/IFCR/CSELR
+} dma_channel_info_t;
+
+typedef struct dma_route {
+    uint8_t channel;                  // channel number, DMA_CHANNEL_NONE if unused
+    uint8_t selector;                 // CSELR value of the request on that channel
+} dma_route_t;
+
+static const dma_channel_info_t dma_channels[DMA_CHANNEL_NUM] = {
+    {DMA1, DMA1_Channel1, DMA1_CSELR, DMA1_Channel1_IRQn,  0},
+    {DMA1, DMA1_Channel2, DMA1_CSELR, DMA1_Channel2_IRQn,  4},
+    {DMA1, DMA1_Channel3, DMA1_CSELR, DMA1_Channel3_IRQn,  8},
+    {DMA1, DMA1_Channel4, DMA1_CSELR, DMA1_Channel4_IRQn, 12},
+    {DMA1, DMA1_Channel5, DMA1_CSELR, DMA1_Channel5_IRQn, 16},
+    {DMA1, DMA1_Channel6, DMA1_CSELR, DMA1_Channel6_IRQn, 20},
+    {DMA1, DMA1_Channel7, DMA1_CSELR, DMA1_Channel7_IRQn, 24},
+    {DMA2, DMA2_Channel1, DMA2_CSELR, DMA2_Channel1_IRQn,  0},
+    {DMA2, DMA2_Channel2, DMA2_CSELR, DMA2_Channel2_IRQn,  4},
+    {DMA2, DMA2_Channel3, DMA2_CSELR, DMA2_Channel3_IRQn,  8},
+    {DMA2, DMA2_Channel4, DMA2_CSELR, DMA2_Channel4_IRQn, 12},
+    {DMA2, DMA2_Channel5, DMA2_CSELR, DMA2_Channel5_IRQn, 16},
+    {DMA2, DMA2_Channel6, DMA2_CSELR, DMA2_Channel6_IRQn, 20},
+    {DMA2, DMA2_Channel7, DMA2_CSELR, DMA2_Channel7_IRQn, 24},
+};
+
+// Request mapping, see RM0351 "DMA1 requests for each channel" and "DMA2 requests for each channel"
+// Channels 1..7 are DMA1, channels 8..14 are DMA2
+// Warning: order must be the same as the one defined in DMARequestName !!!
+static const dma_route_t dma_routes[DMA_REQ_NUM][DMA_ROUTE_NUM] = {
+    {{ 4, 2}, {13, 2}}, // USART1_TX:  DMA1_Ch4, DMA2_Ch6
+    {{ 5, 2}, {14, 2}}, // USART1_RX:  DMA1_Ch5, DMA2_Ch7
+    {{ 7, 2}, { 0, 0}}, // USART2_TX:  DMA1_Ch7
+    {{ 6, 2}, { 0, 0}}, // USART2_RX:  DMA1_Ch6
+    {{ 2, 2}, { 0, 0}}, // USART3_TX:  DMA1_Ch2
+    {{ 3, 2}, { 0, 0}}, // USART3_RX:  DMA1_Ch3
+    {{10, 2}, { 0, 0}}, // UART4_TX:   DMA2_Ch3
+    {{12, 2}, { 0, 0}}, // UART4_RX:   DMA2_Ch5
+    {{ 8, 2}, { 0, 0}}, // UART5_TX:   DMA2_Ch1
+    {{ 9, 2}, { 0, 0}}, // UART5_RX:   DMA2_Ch2
+    {{13, 4}, { 0, 0}}, // LPUART1_TX: DMA2_Ch6
+    {{14, 4}, { 0, 0}}, // LPUART1_RX: DMA2_Ch7
+    {{ 3, 1}, {11, 4}}, // SPI1_TX:    DMA1_Ch3, DMA2_Ch4
+    {{ 2, 1}, {10, 4}}, // SPI1_RX:    DMA1_Ch2, DMA2_Ch3
+    {{ 5, 1}, { 0, 0}}, // SPI2_TX:    DMA1_Ch5
+    {{ 4, 1}, { 0, 0}}, // SPI2_RX:    DMA1_Ch4
+    {{ 9, 3}, { 0, 0}}, // SPI3_TX:    DMA2_Ch2
+    {{ 8, 3}, { 0, 0}}, // SPI3_RX:    DMA2_Ch1
+    {{ 6, 3}, {14, 5}}, // I2C1_TX:    DMA1_Ch6, DMA2_Ch7
+    {{ 7, 3}, {13, 5}}, // I2C1_RX:    DMA1_Ch7, DMA2_Ch6
+    {{ 4, 3}, { 0, 0}}, // I2C2_TX:    DMA1_Ch4
+    {{ 5, 3}, { 0, 0}}, // I2C2_RX:    DMA1_Ch5
+    {{ 2, 3}, { 0, 0}}, // I2C3_TX:    DMA1_Ch2
+    {{ 3, 3}, { 0, 0}}, // I2C3_RX:    DMA1_Ch3
+    {{ 5, 5}, {14, 3}}, // QUADSPI:    DMA1_Ch5, DMA2_Ch7
+};
+
+// bitmask of the channels currently claimed (bit 0 = channel 1)
+static uint32_t dma_channels_used = 0;
+
+static inline const dma_channel_info_t *dma_channel_get(int channel)
+{
+    MBED_ASSERT((channel > DMA_CHANNEL_NONE) && (channel <= DMA_CHANNEL_NUM));
+    return &dma_channels[channel - 1];
+}
+
+int dma_channel_claim(DMARequestName request)
+{
+    int channel = DMA_CHANNEL_NONE;
+    int i;
+
+    MBED_ASSERT(request < DMA_REQ_NUM);
+
+    // claims can come from thread and interrupt context alike
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    for (i = 0; i < DMA_ROUTE_NUM; i++) {
+        const dma_route_t *route = &dma_routes[request][i];
+        if ((route->channel != DMA_CHANNEL_NONE) && !(dma_channels_used & (1 << (route->channel - 1)))) {
+            dma_channels_used |= (1 << (route->channel - 1));
+            channel = route->channel;
+            break;
+        }
+    }
+
+    __set_PRIMASK(primask);
+
+    if (channel == DMA_CHANNEL_NONE) {
+        return DMA_CHANNEL_NONE;
+    }
+
+    const dma_channel_info_t *info = dma_channel_get(channel);
+    if (info->dma == DMA1) {
+        __HAL_RCC_DMA1_CLK_ENABLE();
+    } else {
+        __HAL_RCC_DMA2_CLK_ENABLE();
+    }
+
+    // make sure the channel is idle before routing the new request to it
+    info->channel->CCR = 0;
+    info->dma->IFCR = (DMA_IFCR_CGIF1 << info->shift);
+    info->cselr->CSELR = (info->cselr->CSELR & ~(0xFU << info->shift)) | ((uint32_t)dma_routes[request][i].selector << info->shift);
+
+    return channel;
+}
+
+void dma_channel_release(int channel)
+{
+    if (channel == DMA_CHANNEL_NONE) {
+        return;
+    }
+
+    dma_channel_stop(channel);
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    dma_channels_used &= ~(1 << (channel - 1));
+    __set_PRIMASK(primask);
+}
+
+DMA_Channel_TypeDef *dma_channel_instance(int channel)
+{
+    return dma_channel_get(channel)->channel;
+}
+
+IRQn_Type dma_channel_irq(int channel)
+{
+    return dma_channel_get(channel)->irq;
+}
+
+void dma_channel_start(int channel, uint32_t ccr, volatile void *periph, const void *mem, uint16_t count)
+{
+    const dma_channel_info_t *info = dma_channel_get(channel);
+
+    // the channel has to be disabled to be reprogrammed
+    info->channel->CCR = 0;
+    info->dma->IFCR = (DMA_IFCR_CGIF1 << info->shift);
+
+    info->channel->CPAR  = (uint32_t)periph;
+    info->channel->CMAR  = (uint32_t)mem;
+    info->channel->CNDTR = count;
+    info->channel->CCR   = ccr | DMA_CCR_EN;
+}
+
+void dma_channel_stop(int channel)
+{
+    const dma_channel_info_t *info = dma_channel_get(channel);
+
+    info->channel->CCR &= ~(DMA_CCR_EN | DMA_CCR_TCIE | DMA_CCR_HTIE | DMA_CCR_TEIE);
+    info->dma->IFCR = (DMA_IFCR_CGIF1 << info->shift);
+}
+
+uint16_t dma_channel_remaining(int channel)
+{
+    return (uint16_t)dma_channel_get(channel)->channel->CNDTR;
+}
+
+uint32_t dma_channel_flags(int channel)
+{
+    const dma_channel_info_t *info = dma_channel_get(channel);
+    return (info->dma->ISR >> info->shift) & 0xFU;
+}
+
+void dma_channel_clear(int channel, uint32_t flags)
+{
+    const dma_channel_info_t *info = dma_channel_get(channel);
+    info->dma->IFCR = (flags & 0xFU) << info->shift;
+}
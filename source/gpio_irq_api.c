@@ -50,6 +50,7 @@ typedef struct gpio_channel {
     uint32_t channel_ids[MAX_PIN_LINE];  // mbed "gpio_irq_t gpio_irq" field of instance
     uint32_t channel_gpio[MAX_PIN_LINE]; // base address of gpio port group
     uint32_t channel_pin[MAX_PIN_LINE];  // pin number in port group
+    gpio_irq_handler channel_handlers[MAX_PIN_LINE]; // handler given to gpio_irq_init()
 } gpio_channel_t;
 
 static gpio_channel_t channels[CHANNEL_NUM] = {
@@ -89,8 +90,6 @@ static uint32_t pin_base_nr[16] = {
     5  // pin 15
 };
 
-static gpio_irq_handler irq_handler;
-
 static void handle_interrupt_in(uint32_t irq_index, uint32_t max_num_pin_line)
 {
     gpio_channel_t *gpio_channel = &channels[irq_index];
@@ -112,9 +111,9 @@ static void handle_interrupt_in(uint32_t irq_index, uint32_t max_num_pin_line)
 
                 // Check which edge has generated the irq
                 if ((gpio->IDR & pin) == 0) {
-                    irq_handler(gpio_channel->channel_ids[gpio_idx], IRQ_FALL);
+                    gpio_channel->channel_handlers[gpio_idx](gpio_channel->channel_ids[gpio_idx], IRQ_FALL);
                 } else  {
-                    irq_handler(gpio_channel->channel_ids[gpio_idx], IRQ_RISE);
+                    gpio_channel->channel_handlers[gpio_idx](gpio_channel->channel_ids[gpio_idx], IRQ_RISE);
                 }
             }
         }
@@ -251,8 +250,7 @@ int gpio_irq_init(gpio_irq_t *obj, PinName pin, gpio_irq_handler handler, uint32
     gpio_channel->channel_ids[gpio_idx] = id;
     gpio_channel->channel_gpio[gpio_idx] = gpio_add;
     gpio_channel->channel_pin[gpio_idx] = pin_index;
-
-    irq_handler = handler;
+    gpio_channel->channel_handlers[gpio_idx] = handler;
 
     return 0;
 }
@@ -267,6 +265,7 @@ void gpio_irq_free(gpio_irq_t *obj)
     gpio_channel->channel_ids[gpio_idx] = 0;
     gpio_channel->channel_gpio[gpio_idx] = 0;
     gpio_channel->channel_pin[gpio_idx] = 0;
+    gpio_channel->channel_handlers[gpio_idx] = NULL;
 
     // Disable EXTI line
     pin_function(obj->pin, STM_PIN_DATA(STM_MODE_INPUT, GPIO_NOPULL, 0));
@@ -36,6 +36,17 @@
 #include "pinmap.h"
 #include "mbed-drivers/mbed_error.h"
 #include "PeripheralPins.h"
+#if DEVICE_I2C_ASYNCH
+#include "uvisor-lib/uvisor-lib.h"
+#include "dma_channel.h"
+#endif
+
+// i2c_t wraps the i2c_s of the target with the transfer buffers in asynch builds
+#if DEVICE_I2C_ASYNCH
+#   define I2C_S(obj) (&(obj)->i2c)
+#else
+#   define I2C_S(obj) (obj)
+#endif
 
 /* Timeout values for flags and events waiting loops. These timeouts are
    not based on accurate values, they just guarantee that the application will
@@ -57,11 +68,11 @@ void i2c_init(i2c_t *obj, PinName sda, PinName scl)
     I2CName i2c_sda = (I2CName)pinmap_peripheral(sda, PinMap_I2C_SDA);
     I2CName i2c_scl = (I2CName)pinmap_peripheral(scl, PinMap_I2C_SCL);
 
-    obj->i2c = (I2CName)pinmap_merge(i2c_sda, i2c_scl);
-    MBED_ASSERT(obj->i2c != (I2CName)NC);
+    I2C_S(obj)->i2c = (I2CName)pinmap_merge(i2c_sda, i2c_scl);
+    MBED_ASSERT(I2C_S(obj)->i2c != (I2CName)NC);
 
     // Enable I2C1 clock and pinout if not done
-    if ((obj->i2c == I2C_1) && !i2c1_inited) {
+    if ((I2C_S(obj)->i2c == I2C_1) && !i2c1_inited) {
         i2c1_inited = 1;
         __HAL_RCC_I2C1_CONFIG(RCC_I2C1CLKSOURCE_SYSCLK);
         __HAL_RCC_I2C1_CLK_ENABLE();
@@ -73,7 +84,7 @@ void i2c_init(i2c_t *obj, PinName sda, PinName scl)
     }
 
     // Enable I2C2 clock and pinout if not done
-    if ((obj->i2c == I2C_2) && !i2c2_inited) {
+    if ((I2C_S(obj)->i2c == I2C_2) && !i2c2_inited) {
         i2c2_inited = 1;
         __HAL_RCC_I2C2_CLK_ENABLE();
         // Configure I2C pins
@@ -85,7 +96,7 @@ void i2c_init(i2c_t *obj, PinName sda, PinName scl)
 
 #if defined(I2C3_BASE)
     // Enable I2C3 clock and pinout if not done
-    if ((obj->i2c == I2C_3) && !i2c3_inited) {
+    if ((I2C_S(obj)->i2c == I2C_3) && !i2c3_inited) {
         i2c3_inited = 1;
         __HAL_RCC_I2C3_CLK_ENABLE();
         // Configure I2C pins
@@ -106,7 +117,7 @@ void i2c_init(i2c_t *obj, PinName sda, PinName scl)
 void i2c_frequency(i2c_t *obj, int hz)
 {
     MBED_ASSERT((hz == 100000) || (hz == 400000) || (hz == 1000000));
-    I2cHandle.Instance = (I2C_TypeDef *)(obj->i2c);
+    I2cHandle.Instance = (I2C_TypeDef *)(I2C_S(obj)->i2c);
     int timeout;
 
     // wait before init
@@ -144,10 +155,10 @@ void i2c_frequency(i2c_t *obj, int hz)
 
 inline int i2c_start(i2c_t *obj)
 {
-    I2C_TypeDef *i2c = (I2C_TypeDef *)(obj->i2c);
+    I2C_TypeDef *i2c = (I2C_TypeDef *)(I2C_S(obj)->i2c);
     int timeout;
 
-    I2cHandle.Instance = (I2C_TypeDef *)(obj->i2c);
+    I2cHandle.Instance = (I2C_TypeDef *)(I2C_S(obj)->i2c);
 
     // Clear Acknowledge failure flag
     __HAL_I2C_CLEAR_FLAG(&I2cHandle, I2C_FLAG_AF);
@@ -176,7 +187,7 @@ inline int i2c_start(i2c_t *obj)
 
 inline int i2c_stop(i2c_t *obj)
 {
-    I2C_TypeDef *i2c = (I2C_TypeDef *)(obj->i2c);
+    I2C_TypeDef *i2c = (I2C_TypeDef *)(I2C_S(obj)->i2c);
 
     // Generate the STOP condition
     i2c->CR2 |= I2C_CR2_STOP;
@@ -186,8 +197,8 @@ inline int i2c_stop(i2c_t *obj)
 
 int i2c_read(i2c_t *obj, int address, char *data, int length, int stop)
 {
-    I2C_TypeDef *i2c = (I2C_TypeDef *)(obj->i2c);
-    I2cHandle.Instance = (I2C_TypeDef *)(obj->i2c);
+    I2C_TypeDef *i2c = (I2C_TypeDef *)(I2C_S(obj)->i2c);
+    I2cHandle.Instance = (I2C_TypeDef *)(I2C_S(obj)->i2c);
     int timeout;
     int count;
     int value;
@@ -233,8 +244,8 @@ int i2c_read(i2c_t *obj, int address, char *data, int length, int stop)
 
 int i2c_write(i2c_t *obj, int address, const char *data, int length, int stop)
 {
-    I2C_TypeDef *i2c = (I2C_TypeDef *)(obj->i2c);
-    I2cHandle.Instance = (I2C_TypeDef *)(obj->i2c);
+    I2C_TypeDef *i2c = (I2C_TypeDef *)(I2C_S(obj)->i2c);
+    I2cHandle.Instance = (I2C_TypeDef *)(I2C_S(obj)->i2c);
     int timeout;
     int count;
 
@@ -277,7 +288,7 @@ int i2c_write(i2c_t *obj, int address, const char *data, int length, int stop)
 
 int i2c_byte_read(i2c_t *obj, int last)
 {
-    I2C_TypeDef *i2c = (I2C_TypeDef *)(obj->i2c);
+    I2C_TypeDef *i2c = (I2C_TypeDef *)(I2C_S(obj)->i2c);
     int timeout;
 
     // Wait until the byte is received
@@ -293,7 +304,7 @@ int i2c_byte_read(i2c_t *obj, int last)
 
 int i2c_byte_write(i2c_t *obj, int data)
 {
-    I2C_TypeDef *i2c = (I2C_TypeDef *)(obj->i2c);
+    I2C_TypeDef *i2c = (I2C_TypeDef *)(I2C_S(obj)->i2c);
     int timeout;
 
     // Wait until the previous byte is transmitted
@@ -317,11 +328,11 @@ void i2c_reset(i2c_t *obj)
     timeout = LONG_TIMEOUT;
     while ((__HAL_I2C_GET_FLAG(&I2cHandle, I2C_FLAG_BUSY)) && (timeout-- != 0));
 
-    if (obj->i2c == I2C_1) {
+    if (I2C_S(obj)->i2c == I2C_1) {
         __HAL_RCC_I2C1_FORCE_RESET();
         __HAL_RCC_I2C1_RELEASE_RESET();
     }
-    if (obj->i2c == I2C_2) {
+    if (I2C_S(obj)->i2c == I2C_2) {
         __HAL_RCC_I2C2_FORCE_RESET();
         __HAL_RCC_I2C2_RELEASE_RESET();
     }
@@ -331,7 +342,7 @@ void i2c_reset(i2c_t *obj)
 
 void i2c_slave_address(i2c_t *obj, int idx, uint32_t address, uint32_t mask)
 {
-    I2C_TypeDef *i2c = (I2C_TypeDef *)(obj->i2c);
+    I2C_TypeDef *i2c = (I2C_TypeDef *)(I2C_S(obj)->i2c);
     uint16_t tmpreg;
 
     // disable
@@ -351,7 +362,7 @@ void i2c_slave_address(i2c_t *obj, int idx, uint32_t address, uint32_t mask)
 void i2c_slave_mode(i2c_t *obj, int enable_slave)
 {
 
-    I2C_TypeDef *i2c = (I2C_TypeDef *)(obj->i2c);
+    I2C_TypeDef *i2c = (I2C_TypeDef *)(I2C_S(obj)->i2c);
     uint16_t tmpreg;
 
     // Get the old register value
@@ -377,7 +388,7 @@ void i2c_slave_mode(i2c_t *obj, int enable_slave)
 
 int i2c_slave_receive(i2c_t *obj)
 {
-    I2cHandle.Instance = (I2C_TypeDef *)(obj->i2c);
+    I2cHandle.Instance = (I2C_TypeDef *)(I2C_S(obj)->i2c);
     int retValue = NoData;
 
     if (__HAL_I2C_GET_FLAG(&I2cHandle, I2C_FLAG_BUSY) == 1) {
@@ -405,7 +416,7 @@ int i2c_slave_read(i2c_t *obj, char *data, int length)
 int i2c_slave_write(i2c_t *obj, const char *data, int length)
 {
     char size = 0;
-    I2cHandle.Instance = (I2C_TypeDef *)(obj->i2c);
+    I2cHandle.Instance = (I2C_TypeDef *)(I2C_S(obj)->i2c);
 
     do {
         i2c_byte_write(obj, data[size]);
@@ -418,4 +429,318 @@ int i2c_slave_write(i2c_t *obj, const char *data, int length)
 
 #endif // DEVICE_I2CSLAVE
 
+#if DEVICE_I2C_ASYNCH
+
+#if defined(I2C3_BASE)
+#define I2C_NUM (3)
+#else
+#define I2C_NUM (2)
+#endif
+
+static const IRQn_Type I2cEventIRQs[I2C_NUM] = {
+    I2C1_EV_IRQn,
+    I2C2_EV_IRQn,
+#if defined(I2C3_BASE)
+    I2C3_EV_IRQn,
+#endif
+};
+
+static const IRQn_Type I2cErrorIRQs[I2C_NUM] = {
+    I2C1_ER_IRQn,
+    I2C2_ER_IRQn,
+#if defined(I2C3_BASE)
+    I2C3_ER_IRQn,
+#endif
+};
+
+static const DMARequestName I2cTxDmaRequests[I2C_NUM] = {
+    DMA_REQ_I2C1_TX,
+    DMA_REQ_I2C2_TX,
+#if defined(I2C3_BASE)
+    DMA_REQ_I2C3_TX,
+#endif
+};
+
+static const DMARequestName I2cRxDmaRequests[I2C_NUM] = {
+    DMA_REQ_I2C1_RX,
+    DMA_REQ_I2C2_RX,
+#if defined(I2C3_BASE)
+    DMA_REQ_I2C3_RX,
+#endif
+};
+
+// Master transfers: a write phase, a read phase after a repeated start, or both
+typedef struct i2c_asynch {
+    uint32_t address;
+    uint32_t event;             // events to report
+    uint32_t result;            // NACK seen, reported once STOP is out
+    size_t left;                // bytes of the phase not programmed in NBYTES yet
+    int tx_channel;             // DMA channels, DMA_CHANNEL_NONE for the interrupt path
+    int rx_channel;
+    uint8_t keep;
+    uint8_t dma;                // the current transfer moves its bytes with the channels
+    uint8_t stop;
+    uint8_t reading;
+    uint8_t active;
+} i2c_asynch_t;
+
+static i2c_asynch_t I2cAsynch[I2C_NUM] = {
+    {.tx_channel = DMA_CHANNEL_NONE, .rx_channel = DMA_CHANNEL_NONE},
+    {.tx_channel = DMA_CHANNEL_NONE, .rx_channel = DMA_CHANNEL_NONE},
+#if defined(I2C3_BASE)
+    {.tx_channel = DMA_CHANNEL_NONE, .rx_channel = DMA_CHANNEL_NONE},
+#endif
+};
+
+static int i2c_module(i2c_t *obj)
+{
+    switch (I2C_S(obj)->i2c) {
+        case I2C_1:
+            return 0;
+        case I2C_2:
+            return 1;
+#if defined(I2C3_BASE)
+        case I2C_3:
+            return 2;
+#endif
+        default:
+            error("I2C: no such instance\n");
+            return 0;
+    }
+}
+
+// NBYTES counts up to 255 bytes, RELOAD chains the rest of the phase
+static uint32_t i2c_nbytes(size_t *left)
+{
+    size_t count = (*left > 255) ? 255 : *left;
+
+    *left -= count;
+    return ((uint32_t)count << 16) | (*left ? I2C_CR2_RELOAD : 0);
+}
+
+static void i2c_dma_release(i2c_asynch_t *asynch)
+{
+    if (asynch->tx_channel != DMA_CHANNEL_NONE) {
+        dma_channel_stop(asynch->tx_channel);
+    }
+    if (asynch->rx_channel != DMA_CHANNEL_NONE) {
+        dma_channel_stop(asynch->rx_channel);
+    }
+    if (!asynch->keep) {
+        dma_channel_release(asynch->tx_channel);
+        dma_channel_release(asynch->rx_channel);
+        asynch->tx_channel = DMA_CHANNEL_NONE;
+        asynch->rx_channel = DMA_CHANNEL_NONE;
+    }
+}
+
+/// @returns 1 if the buffers in use have their DMA channels
+static int i2c_dma_claim(i2c_t *obj, int module, DMAUsage hint)
+{
+    i2c_asynch_t *asynch = &I2cAsynch[module];
+    int tx = (obj->tx_buff.length > 0);
+    int rx = (obj->rx_buff.length > 0);
+
+    // a channel counts up to 65535 bytes
+    if ((hint == DMA_USAGE_NEVER) || (obj->tx_buff.length > 0xFFFF) || (obj->rx_buff.length > 0xFFFF)) {
+        // don't leave channels of an earlier DMA_USAGE_ALWAYS transfer behind
+        asynch->keep = 0;
+        i2c_dma_release(asynch);
+        return 0;
+    }
+
+    if (tx && (asynch->tx_channel == DMA_CHANNEL_NONE)) {
+        asynch->tx_channel = dma_channel_claim(I2cTxDmaRequests[module]);
+    }
+    if (rx && (asynch->rx_channel == DMA_CHANNEL_NONE)) {
+        asynch->rx_channel = dma_channel_claim(I2cRxDmaRequests[module]);
+    }
+    if ((tx && (asynch->tx_channel == DMA_CHANNEL_NONE)) || (rx && (asynch->rx_channel == DMA_CHANNEL_NONE))) {
+        asynch->keep = 0;
+        i2c_dma_release(asynch);
+        return 0;
+    }
+    asynch->keep = (hint == DMA_USAGE_ALWAYS);
+
+    return 1;
+}
+
+static void i2c_asynch_finish(i2c_t *obj)
+{
+    I2C_TypeDef *i2c = (I2C_TypeDef *)(I2C_S(obj)->i2c);
+    i2c_asynch_t *asynch = &I2cAsynch[i2c_module(obj)];
+
+    i2c->CR1 &= ~(I2C_CR1_TXIE | I2C_CR1_RXIE | I2C_CR1_TCIE | I2C_CR1_STOPIE | I2C_CR1_NACKIE | I2C_CR1_ERRIE |
+                  I2C_CR1_TXDMAEN | I2C_CR1_RXDMAEN);
+
+    // what the DMA channels moved
+    if (asynch->dma) {
+        if (obj->tx_buff.length) {
+            obj->tx_buff.pos = obj->tx_buff.length - dma_channel_remaining(asynch->tx_channel);
+        }
+        if (obj->rx_buff.length) {
+            obj->rx_buff.pos = obj->rx_buff.length - dma_channel_remaining(asynch->rx_channel);
+        }
+    }
+    i2c_dma_release(asynch);
+
+    asynch->dma = 0;
+    asynch->active = 0;
+}
+
+// START, or a repeated start after the write phase, then the first NBYTES chunk
+static void i2c_phase_start(i2c_t *obj, int read)
+{
+    I2C_TypeDef *i2c = (I2C_TypeDef *)(I2C_S(obj)->i2c);
+    i2c_asynch_t *asynch = &I2cAsynch[i2c_module(obj)];
+    buffer_t *buffer = read ? &obj->rx_buff : &obj->tx_buff;
+    int channel = read ? asynch->rx_channel : asynch->tx_channel;
+
+    asynch->reading = read;
+    asynch->left = buffer->length;
+
+    // the channel waits for the first TXIS/RXNE request
+    if (asynch->dma && buffer->length) {
+        dma_channel_start(channel, DMA_CCR_MINC | (read ? 0 : DMA_CCR_DIR),
+                          read ? (volatile void *)&i2c->RXDR : (volatile void *)&i2c->TXDR,
+                          buffer->buffer, (uint16_t)buffer->length);
+    }
+
+    i2c->CR2 = (asynch->address & I2C_CR2_SADD) | (read ? I2C_CR2_RD_WRN : 0) | i2c_nbytes(&asynch->left) | I2C_CR2_START;
+}
+
+void i2c_transfer_asynch(i2c_t *obj, const void *tx, size_t tx_length, void *rx, size_t rx_length, uint32_t address, uint32_t stop, uint32_t handler, uint32_t event, DMAUsage hint)
+{
+    I2C_TypeDef *i2c = (I2C_TypeDef *)(I2C_S(obj)->i2c);
+    int module = i2c_module(obj);
+    i2c_asynch_t *asynch = &I2cAsynch[module];
+
+    obj->tx_buff.buffer = (void *)tx;
+    obj->tx_buff.length = tx ? tx_length : 0;
+    obj->tx_buff.pos = 0;
+    obj->tx_buff.width = 8;
+    obj->rx_buff.buffer = rx;
+    obj->rx_buff.length = rx ? rx_length : 0;
+    obj->rx_buff.pos = 0;
+    obj->rx_buff.width = 8;
+
+    asynch->address = address;
+    asynch->event = event;
+    asynch->result = 0;
+    asynch->stop = stop;
+    asynch->active = 1;
+
+    vIRQ_SetVector(I2cEventIRQs[module], handler);
+    vIRQ_EnableIRQ(I2cEventIRQs[module]);
+    vIRQ_SetVector(I2cErrorIRQs[module], handler);
+    vIRQ_EnableIRQ(I2cErrorIRQs[module]);
+
+    // the interrupts only see the phase changes with DMA, every byte otherwise
+    uint32_t cr1 = I2C_CR1_TCIE | I2C_CR1_STOPIE | I2C_CR1_NACKIE | I2C_CR1_ERRIE;
+    asynch->dma = i2c_dma_claim(obj, module, hint);
+    if (asynch->dma) {
+        cr1 |= I2C_CR1_TXDMAEN | I2C_CR1_RXDMAEN;
+    } else {
+        cr1 |= I2C_CR1_TXIE | I2C_CR1_RXIE;
+    }
+    i2c->ICR = I2C_ICR_NACKCF | I2C_ICR_STOPCF | I2C_ICR_BERRCF | I2C_ICR_ARLOCF | I2C_ICR_OVRCF;
+    i2c->CR1 |= cr1;
+
+    // an address only transfer probes the slave with a write
+    i2c_phase_start(obj, (obj->tx_buff.length == 0) && (obj->rx_buff.length > 0));
+}
+
+uint32_t i2c_irq_handler_asynch(i2c_t *obj)
+{
+    I2C_TypeDef *i2c = (I2C_TypeDef *)(I2C_S(obj)->i2c);
+    i2c_asynch_t *asynch = &I2cAsynch[i2c_module(obj)];
+    uint32_t isr = i2c->ISR;
+    uint32_t event = 0;
+
+    if (!asynch->active)
+        return 0;
+
+    if (isr & (I2C_ISR_BERR | I2C_ISR_ARLO | I2C_ISR_OVR)) {
+        // the bus is gone, no STOP to wait for
+        i2c->ICR = I2C_ICR_BERRCF | I2C_ICR_ARLOCF | I2C_ICR_OVRCF;
+        i2c_asynch_finish(obj);
+        return (I2C_EVENT_ERROR & asynch->event);
+    }
+
+    if (isr & I2C_ISR_NACKF) {
+        i2c->ICR = I2C_ICR_NACKCF;
+        // the address is the only byte a slave can refuse before TXIS ever asked for data
+        int no_data;
+        if (asynch->dma && obj->tx_buff.length) {
+            no_data = (dma_channel_remaining(asynch->tx_channel) == obj->tx_buff.length);
+        } else {
+            no_data = (obj->tx_buff.pos == 0);
+        }
+        asynch->result = (asynch->reading || no_data) ? (I2C_EVENT_ERROR | I2C_EVENT_ERROR_NO_SLAVE)
+                                                      : (I2C_EVENT_ERROR | I2C_EVENT_TRANSFER_EARLY_NACK);
+        // software end mode: the STOP is ours to send
+        i2c->CR2 |= I2C_CR2_STOP;
+        return 0;
+    }
+
+    if (isr & I2C_ISR_STOPF) {
+        i2c->ICR = I2C_ICR_STOPCF;
+        i2c_asynch_finish(obj);
+        event = asynch->result ? asynch->result : I2C_EVENT_TRANSFER_COMPLETE;
+        return (event & asynch->event);
+    }
+
+    // with DMA the data registers belong to the channels, even when TC shows up with the last RXNE
+    if (!asynch->dma) {
+        if ((isr & I2C_ISR_TXIS) && (obj->tx_buff.pos < obj->tx_buff.length)) {
+            i2c->TXDR = ((const uint8_t *)obj->tx_buff.buffer)[obj->tx_buff.pos++];
+        }
+        if ((isr & I2C_ISR_RXNE) && (obj->rx_buff.pos < obj->rx_buff.length)) {
+            ((uint8_t *)obj->rx_buff.buffer)[obj->rx_buff.pos++] = (uint8_t)i2c->RXDR;
+        }
+    }
+
+    if (isr & I2C_ISR_TCR) {
+        // next chunk of the same phase, no START
+        i2c->CR2 = (i2c->CR2 & ~(I2C_CR2_NBYTES | I2C_CR2_RELOAD | I2C_CR2_START)) | i2c_nbytes(&asynch->left);
+    } else if (isr & I2C_ISR_TC) {
+        if (!asynch->reading && obj->rx_buff.length) {
+            i2c_phase_start(obj, 1);
+        } else if (asynch->stop) {
+            i2c->CR2 |= I2C_CR2_STOP;
+        } else {
+            // no STOP: SCL is held low until the next START
+            i2c_asynch_finish(obj);
+            return (I2C_EVENT_TRANSFER_COMPLETE & asynch->event);
+        }
+    }
+
+    return 0;
+}
+
+uint8_t i2c_active(i2c_t *obj)
+{
+    return I2cAsynch[i2c_module(obj)].active;
+}
+
+void i2c_abort_asynch(i2c_t *obj)
+{
+    I2C_TypeDef *i2c = (I2C_TypeDef *)(I2C_S(obj)->i2c);
+    int module = i2c_module(obj);
+
+    if (!I2cAsynch[module].active)
+        return;
+
+    vIRQ_DisableIRQ(I2cEventIRQs[module]);
+    vIRQ_DisableIRQ(I2cErrorIRQs[module]);
+    i2c_asynch_finish(obj);
+
+    // release the bus once the byte in flight is out
+    if (i2c->ISR & I2C_ISR_BUSY) {
+        i2c->CR2 |= I2C_CR2_STOP;
+    }
+}
+
+#endif // DEVICE_I2C_ASYNCH
+
 #endif // DEVICE_I2C
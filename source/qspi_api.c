@@ -0,0 +1,585 @@
+/* mbed Microcontroller Library
+ *******************************************************************************
+ * Copyright (c) 2015, STMicroelectronics
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of STMicroelectronics nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************
+ */
+#include "qspi_api.h"
+
+#if defined(QUADSPI)
+
+#include <stdbool.h>
+#include "uvisor-lib/uvisor-lib.h"
+#include "mbed-drivers/mbed_assert.h"
+#include "pinmap.h"
+#include "PeripheralPins.h"
+#include "dma_channel.h"
+
+// CCR fields
+#define QSPI_CCR_IMODE_POS      (8)
+#define QSPI_CCR_ADMODE_POS     (10)
+#define QSPI_CCR_ADSIZE_POS     (12)
+#define QSPI_CCR_ABMODE_POS     (14)
+#define QSPI_CCR_ABSIZE_POS     (16)
+#define QSPI_CCR_DCYC_POS       (18)
+#define QSPI_CCR_DMODE_POS      (24)
+#define QSPI_CCR_FMODE_POS      (26)
+
+// CCR functional modes
+#define QSPI_FMODE_WRITE        (0U)
+#define QSPI_FMODE_READ         (1U)
+#define QSPI_FMODE_POLL         (2U)
+#define QSPI_FMODE_MAPPED       (3U)
+
+#define QSPI_CR_PRESCALER_POS   (24)
+#define QSPI_CR_FTHRES_POS      (8)
+#define QSPI_DCR_FSIZE_POS      (16)
+#define QSPI_DCR_CSHT_POS       (8)
+#define QSPI_SR_FLEVEL_POS      (8)
+
+#define QSPI_FIFO_SIZE          (16)
+// FIFO threshold interrupt once half of the FIFO can move, DMA requests on every byte
+#define QSPI_FIFO_THRESHOLD_IRQ (8)
+#define QSPI_FIFO_THRESHOLD_DMA (1)
+// nCS high time between commands, in clocks: 4 covers the usual 50 ns up to 80 MHz
+#define QSPI_CS_HIGH_CYCLES     (4)
+
+#define QSPI_FCR_ALL (QUADSPI_FCR_CTEF | QUADSPI_FCR_CTCF | QUADSPI_FCR_CSMF | QUADSPI_FCR_CTOF)
+
+// QUADSPI pins of the STM32L476 ports A and B (AF10), the ones of the 64 pin
+// packages. The pin modules of targets with other pins, such as PE10..PE15 on the
+// larger packages, define their own maps.
+__attribute__((weak)) const PinMap PinMap_QSPI_IO0[] = {
+    {PB_1,  (int)QUADSPI, STM_PIN_DATA(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF10_QUADSPI)},
+    {NC,    (int)NC, 0}
+};
+
+__attribute__((weak)) const PinMap PinMap_QSPI_IO1[] = {
+    {PB_0,  (int)QUADSPI, STM_PIN_DATA(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF10_QUADSPI)},
+    {NC,    (int)NC, 0}
+};
+
+__attribute__((weak)) const PinMap PinMap_QSPI_IO2[] = {
+    {PA_7,  (int)QUADSPI, STM_PIN_DATA(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF10_QUADSPI)},
+    {NC,    (int)NC, 0}
+};
+
+__attribute__((weak)) const PinMap PinMap_QSPI_IO3[] = {
+    {PA_6,  (int)QUADSPI, STM_PIN_DATA(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF10_QUADSPI)},
+    {NC,    (int)NC, 0}
+};
+
+__attribute__((weak)) const PinMap PinMap_QSPI_CLK[] = {
+    {PB_10, (int)QUADSPI, STM_PIN_DATA(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF10_QUADSPI)},
+    {NC,    (int)NC, 0}
+};
+
+__attribute__((weak)) const PinMap PinMap_QSPI_CS[] = {
+    {PB_11, (int)QUADSPI, STM_PIN_DATA(STM_MODE_AF_PP, GPIO_PULLUP, GPIO_AF10_QUADSPI)},
+    {NC,    (int)NC, 0}
+};
+
+// Indirect transfers and polls, a single controller
+typedef struct qspi_transfer {
+    uint8_t *buffer;
+    size_t length;
+    size_t pos;
+    int channel;                // DMA channel, DMA_CHANNEL_NONE for the FIFO interrupt
+    uint16_t count;             // bytes of the running DMA chunk
+    uint8_t keep;               // DMA_USAGE_ALWAYS: the channel stays claimed between transfers
+    uint8_t read;
+    uint8_t poll;
+    uint8_t done;               // TCF seen, the DMA may still move the last bytes
+    uint8_t active;
+    uint8_t mapped;
+} qspi_transfer_t;
+
+static qspi_transfer_t QspiTransfer = {.channel = DMA_CHANNEL_NONE};
+
+static PinName QspiPins[6] = {NC, NC, NC, NC, NC, NC};
+
+static uint32_t qspi_ccr(const qspi_command_t *command, uint32_t fmode)
+{
+    uint32_t ccr = (fmode << QSPI_CCR_FMODE_POS) |
+                   ((uint32_t)command->data_lines << QSPI_CCR_DMODE_POS) |
+                   ((uint32_t)(command->dummy_cycles & 0x1F) << QSPI_CCR_DCYC_POS) |
+                   ((uint32_t)command->instruction_lines << QSPI_CCR_IMODE_POS) |
+                   command->instruction;
+
+    if (command->address_lines != QSPI_LINES_NONE) {
+        ccr |= ((uint32_t)command->address_lines << QSPI_CCR_ADMODE_POS) |
+               ((uint32_t)((command->address_bytes - 1) & 3) << QSPI_CCR_ADSIZE_POS);
+    }
+    if (command->alternate_lines != QSPI_LINES_NONE) {
+        ccr |= ((uint32_t)command->alternate_lines << QSPI_CCR_ABMODE_POS) |
+               ((uint32_t)((command->alternate_bytes - 1) & 3) << QSPI_CCR_ABSIZE_POS);
+    }
+    return ccr;
+}
+
+// The command starts on AR with an address phase, on the first data byte for an
+// indirect write, on CCR otherwise
+static void qspi_start(const qspi_command_t *command, uint32_t fmode, size_t length)
+{
+    QUADSPI_TypeDef *qspi = QUADSPI;
+
+    if (length) {
+        qspi->DLR = length - 1;
+    }
+    if (command->alternate_lines != QSPI_LINES_NONE) {
+        qspi->ABR = command->alternate;
+    }
+    qspi->CCR = qspi_ccr(command, fmode);
+    if ((command->address_lines != QSPI_LINES_NONE) && (fmode != QSPI_FMODE_MAPPED)) {
+        qspi->AR = command->address;
+    }
+}
+
+// Stop the running command and flush the FIFO
+static void qspi_abort(void)
+{
+    QUADSPI_TypeDef *qspi = QUADSPI;
+
+    qspi->CR |= QUADSPI_CR_ABORT;
+    while (qspi->CR & QUADSPI_CR_ABORT);
+    qspi->FCR = QSPI_FCR_ALL;
+}
+
+// Wait for the controller, out of the memory-mapped mode
+static void qspi_idle(void)
+{
+    if (QspiTransfer.mapped) {
+        qspi_memory_unmap();
+    }
+    while (QUADSPI->SR & QUADSPI_SR_BUSY);
+}
+
+static void qspi_threshold(uint32_t bytes)
+{
+    QUADSPI->CR = (QUADSPI->CR & ~QUADSPI_CR_FTHRES) | ((bytes - 1) << QSPI_CR_FTHRES_POS);
+}
+
+/// @returns 0 once the command completed, -1 on a transfer error
+static int qspi_wait(void)
+{
+    QUADSPI_TypeDef *qspi = QUADSPI;
+    uint32_t sr;
+
+    while (!((sr = qspi->SR) & (QUADSPI_SR_TCF | QUADSPI_SR_TEF)));
+    qspi->FCR = QUADSPI_FCR_CTCF | QUADSPI_FCR_CTEF;
+    if (sr & QUADSPI_SR_TEF) {
+        qspi_abort();
+        return -1;
+    }
+    return 0;
+}
+
+/// Move what the FIFO level allows between the FIFO and the buffer, by words while
+/// 4 bytes fit
+static void qspi_fifo_move(qspi_transfer_t *transfer)
+{
+    QUADSPI_TypeDef *qspi = QUADSPI;
+    size_t level = (qspi->SR & QUADSPI_SR_FLEVEL) >> QSPI_SR_FLEVEL_POS;
+    size_t left = transfer->length - transfer->pos;
+    uint8_t *p = transfer->buffer + transfer->pos;
+    size_t n = transfer->read ? level : (QSPI_FIFO_SIZE - level);
+
+    if (n > left) {
+        n = left;
+    }
+    transfer->pos += n;
+
+    if (transfer->read) {
+        for (; n >= 4; n -= 4, p += 4) {
+            uint32_t word = qspi->DR;
+            p[0] = (uint8_t)word;
+            p[1] = (uint8_t)(word >> 8);
+            p[2] = (uint8_t)(word >> 16);
+            p[3] = (uint8_t)(word >> 24);
+        }
+        while (n--) {
+            *p++ = *(volatile uint8_t *)&qspi->DR;
+        }
+    } else {
+        for (; n >= 4; n -= 4, p += 4) {
+            qspi->DR = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+        }
+        while (n--) {
+            *(volatile uint8_t *)&qspi->DR = *p++;
+        }
+    }
+}
+
+static int qspi_polled(const qspi_command_t *command, uint8_t *buffer, size_t length, bool read)
+{
+    qspi_transfer_t *transfer = &QspiTransfer;
+
+    MBED_ASSERT(command->data_lines != QSPI_LINES_NONE);
+    if (transfer->active)
+        return -1;
+    if (length == 0)
+        return 0;
+
+    qspi_idle();
+    transfer->buffer = buffer;
+    transfer->length = length;
+    transfer->pos = 0;
+    transfer->read = read;
+
+    qspi_threshold(QSPI_FIFO_THRESHOLD_IRQ);
+    qspi_start(command, read ? QSPI_FMODE_READ : QSPI_FMODE_WRITE, length);
+    while ((transfer->pos < length) && !(QUADSPI->SR & QUADSPI_SR_TEF)) {
+        qspi_fifo_move(transfer);
+    }
+
+    return (qspi_wait() == 0) ? (int)length : -1;
+}
+
+static void qspi_dma_next(qspi_transfer_t *transfer)
+{
+    size_t left = transfer->length - transfer->pos;
+
+    transfer->count = (left > 0xFFFF) ? 0xFFFF : (uint16_t)left;
+    dma_channel_start(transfer->channel, DMA_CCR_MINC | DMA_CCR_TCIE | (transfer->read ? 0 : DMA_CCR_DIR),
+                      &QUADSPI->DR, transfer->buffer + transfer->pos, transfer->count);
+}
+
+static void qspi_finish(void)
+{
+    qspi_transfer_t *transfer = &QspiTransfer;
+
+    QUADSPI->CR &= ~(QUADSPI_CR_DMAEN | QUADSPI_CR_TEIE | QUADSPI_CR_TCIE | QUADSPI_CR_FTIE | QUADSPI_CR_SMIE);
+    if (transfer->channel != DMA_CHANNEL_NONE) {
+        if (transfer->keep) {
+            dma_channel_stop(transfer->channel);
+        } else {
+            dma_channel_release(transfer->channel);
+            transfer->channel = DMA_CHANNEL_NONE;
+        }
+    }
+    transfer->poll = 0;
+    transfer->active = 0;
+}
+
+static int qspi_asynch(const qspi_command_t *command, uint8_t *buffer, size_t length, bool read, uint32_t handler, DMAUsage hint)
+{
+    qspi_transfer_t *transfer = &QspiTransfer;
+    QUADSPI_TypeDef *qspi = QUADSPI;
+
+    MBED_ASSERT(command->data_lines != QSPI_LINES_NONE);
+    if (transfer->active || (length == 0))
+        return -1;
+
+    qspi_idle();
+    transfer->buffer = buffer;
+    transfer->length = length;
+    transfer->pos = 0;
+    transfer->read = read;
+    transfer->done = 0;
+    transfer->active = 1;
+
+    vIRQ_SetVector(QUADSPI_IRQn, handler);
+    vIRQ_EnableIRQ(QUADSPI_IRQn);
+
+    if ((hint != DMA_USAGE_NEVER) && (transfer->channel == DMA_CHANNEL_NONE)) {
+        transfer->channel = dma_channel_claim(DMA_REQ_QUADSPI);
+    }
+    transfer->keep = (hint == DMA_USAGE_ALWAYS);
+
+    if (transfer->channel != DMA_CHANNEL_NONE) {
+        IRQn_Type dma_irq_n = dma_channel_irq(transfer->channel);
+        vIRQ_SetVector(dma_irq_n, handler);
+        vIRQ_EnableIRQ(dma_irq_n);
+
+        qspi_threshold(QSPI_FIFO_THRESHOLD_DMA);
+        qspi->CR |= QUADSPI_CR_TEIE | QUADSPI_CR_TCIE;
+        qspi_start(command, read ? QSPI_FMODE_READ : QSPI_FMODE_WRITE, length);
+        qspi_dma_next(transfer);
+        qspi->CR |= QUADSPI_CR_DMAEN;
+    } else {
+        // no channel: the FIFO threshold interrupt moves the data
+        qspi_threshold(QSPI_FIFO_THRESHOLD_IRQ);
+        qspi->CR |= QUADSPI_CR_TEIE | QUADSPI_CR_TCIE | QUADSPI_CR_FTIE;
+        qspi_start(command, read ? QSPI_FMODE_READ : QSPI_FMODE_WRITE, length);
+    }
+
+    return 0;
+}
+
+static void qspi_poll_start(const qspi_command_t *command, uint32_t mask, uint32_t match, size_t bytes, uint16_t interval)
+{
+    QUADSPI_TypeDef *qspi = QUADSPI;
+
+    MBED_ASSERT((command->data_lines != QSPI_LINES_NONE) && (bytes >= 1) && (bytes <= 4));
+
+    qspi->PSMKR = mask;
+    qspi->PSMAR = match;
+    qspi->PIR = interval;
+    // AND of the masked bits, the controller stops polling at the match
+    qspi->CR = (qspi->CR & ~QUADSPI_CR_PMM) | QUADSPI_CR_APMS;
+    qspi_start(command, QSPI_FMODE_POLL, bytes);
+}
+
+int qspi_init(PinName io0, PinName io1, PinName io2, PinName io3, PinName sclk, PinName ssel, uint32_t flash_size)
+{
+    const PinName pins[6] = {io0, io1, io2, io3, sclk, ssel};
+    const PinMap *maps[6] = {PinMap_QSPI_IO0, PinMap_QSPI_IO1, PinMap_QSPI_IO2, PinMap_QSPI_IO3, PinMap_QSPI_CLK, PinMap_QSPI_CS};
+    uint32_t fsize = 0;
+    int i;
+
+    // IO2 and IO3 are the only optional pins
+    for (i = 0; i < 6; i++) {
+        if ((pins[i] == NC) && ((i == 2) || (i == 3)))
+            continue;
+        if (pinmap_find_peripheral(pins[i], maps[i]) != (uint32_t)QUADSPI)
+            return -1;
+    }
+
+    __HAL_RCC_QSPI_CLK_ENABLE();
+    __HAL_RCC_QSPI_FORCE_RESET();
+    __HAL_RCC_QSPI_RELEASE_RESET();
+
+    for (i = 0; i < 6; i++) {
+        pinmap_pinout(pins[i], maps[i]);
+        QspiPins[i] = pins[i];
+    }
+
+    // FSIZE + 1 address bits
+    while ((2U << fsize) < flash_size) {
+        fsize++;
+    }
+
+    // slowest clock until qspi_frequency(), sampling half a clock late for the pad delays
+    QUADSPI->CR = (255U << QSPI_CR_PRESCALER_POS) | QUADSPI_CR_SSHIFT |
+                  ((QSPI_FIFO_THRESHOLD_IRQ - 1) << QSPI_CR_FTHRES_POS);
+    QUADSPI->DCR = (fsize << QSPI_DCR_FSIZE_POS) | ((QSPI_CS_HIGH_CYCLES - 1) << QSPI_DCR_CSHT_POS);
+    QUADSPI->CR |= QUADSPI_CR_EN;
+
+    return 0;
+}
+
+void qspi_free(void)
+{
+    int i;
+
+    qspi_abort_asynch();
+    QspiTransfer.keep = 0;
+    qspi_finish();
+    QspiTransfer.mapped = 0;
+
+    QUADSPI->CR &= ~QUADSPI_CR_EN;
+    __HAL_RCC_QSPI_FORCE_RESET();
+    __HAL_RCC_QSPI_RELEASE_RESET();
+    __HAL_RCC_QSPI_CLK_DISABLE();
+
+    for (i = 0; i < 6; i++) {
+        if (QspiPins[i] != NC) {
+            pin_function(QspiPins[i], STM_PIN_DATA(STM_MODE_INPUT, GPIO_NOPULL, 0));
+            QspiPins[i] = NC;
+        }
+    }
+}
+
+int qspi_frequency(int hz)
+{
+    // the controller runs on HCLK
+    uint32_t clock = HAL_RCC_GetHCLKFreq();
+    uint32_t prescaler = (hz > 0) ? ((clock + (uint32_t)hz - 1) / (uint32_t)hz) : 256;
+
+    if (prescaler < 1) {
+        prescaler = 1;
+    }
+    if (prescaler > 256) {
+        prescaler = 256;
+    }
+
+    qspi_idle();
+    QUADSPI->CR = (QUADSPI->CR & ~QUADSPI_CR_PRESCALER) | ((prescaler - 1) << QSPI_CR_PRESCALER_POS);
+
+    return (int)(clock / prescaler);
+}
+
+int qspi_command(const qspi_command_t *command)
+{
+    MBED_ASSERT(command->data_lines == QSPI_LINES_NONE);
+    if (QspiTransfer.active)
+        return -1;
+
+    qspi_idle();
+    qspi_start(command, QSPI_FMODE_WRITE, 0);
+    return qspi_wait();
+}
+
+int qspi_read(const qspi_command_t *command, void *data, size_t length)
+{
+    return qspi_polled(command, (uint8_t *)data, length, true);
+}
+
+int qspi_write(const qspi_command_t *command, const void *data, size_t length)
+{
+    return qspi_polled(command, (uint8_t *)data, length, false);
+}
+
+int qspi_read_asynch(const qspi_command_t *command, void *data, size_t length, uint32_t handler, DMAUsage hint)
+{
+    return qspi_asynch(command, (uint8_t *)data, length, true, handler, hint);
+}
+
+int qspi_write_asynch(const qspi_command_t *command, const void *data, size_t length, uint32_t handler, DMAUsage hint)
+{
+    return qspi_asynch(command, (uint8_t *)data, length, false, handler, hint);
+}
+
+int qspi_poll(const qspi_command_t *command, uint32_t mask, uint32_t match, size_t bytes, uint16_t interval)
+{
+    QUADSPI_TypeDef *qspi = QUADSPI;
+    uint32_t sr;
+
+    if (QspiTransfer.active)
+        return -1;
+
+    qspi_idle();
+    qspi_poll_start(command, mask, match, bytes, interval);
+
+    while (!((sr = qspi->SR) & (QUADSPI_SR_SMF | QUADSPI_SR_TEF)));
+    qspi->FCR = QUADSPI_FCR_CSMF | QUADSPI_FCR_CTCF | QUADSPI_FCR_CTEF;
+    if (sr & QUADSPI_SR_TEF) {
+        qspi_abort();
+        return -1;
+    }
+    return 0;
+}
+
+int qspi_poll_asynch(const qspi_command_t *command, uint32_t mask, uint32_t match, size_t bytes, uint16_t interval, uint32_t handler)
+{
+    qspi_transfer_t *transfer = &QspiTransfer;
+
+    if (transfer->active)
+        return -1;
+
+    qspi_idle();
+    transfer->poll = 1;
+    transfer->active = 1;
+
+    vIRQ_SetVector(QUADSPI_IRQn, handler);
+    vIRQ_EnableIRQ(QUADSPI_IRQn);
+
+    QUADSPI->CR |= QUADSPI_CR_SMIE | QUADSPI_CR_TEIE;
+    qspi_poll_start(command, mask, match, bytes, interval);
+
+    return 0;
+}
+
+uint32_t qspi_irq_handler_asynch(void)
+{
+    qspi_transfer_t *transfer = &QspiTransfer;
+    QUADSPI_TypeDef *qspi = QUADSPI;
+    uint32_t sr = qspi->SR;
+
+    if (!transfer->active)
+        return 0;
+
+    if (sr & QUADSPI_SR_TEF) {
+        // the access went past the flash size
+        qspi_finish();
+        qspi_abort();
+        return QSPI_EVENT_ERROR;
+    }
+
+    if (transfer->poll) {
+        if (!(sr & QUADSPI_SR_SMF))
+            return 0;
+        qspi->FCR = QUADSPI_FCR_CSMF | QUADSPI_FCR_CTCF;
+        qspi_finish();
+        return QSPI_EVENT_MATCH;
+    }
+
+    if (sr & QUADSPI_SR_TCF) {
+        qspi->FCR = QUADSPI_FCR_CTCF;
+        transfer->done = 1;
+    }
+
+    if (transfer->channel != DMA_CHANNEL_NONE) {
+        if (dma_channel_flags(transfer->channel) & DMA_CHANNEL_FLAG_TC) {
+            dma_channel_clear(transfer->channel, DMA_CHANNEL_FLAG_GI | DMA_CHANNEL_FLAG_TC);
+            transfer->pos += transfer->count;
+            if (transfer->pos < transfer->length) {
+                qspi_dma_next(transfer);
+            }
+        }
+    } else {
+        qspi_fifo_move(transfer);
+        // FTF stays up for writes once the last byte is in the FIFO
+        if (transfer->pos == transfer->length) {
+            qspi->CR &= ~QUADSPI_CR_FTIE;
+        }
+    }
+
+    if (transfer->done && (transfer->pos == transfer->length)) {
+        qspi_finish();
+        return QSPI_EVENT_COMPLETE;
+    }
+    return 0;
+}
+
+uint8_t qspi_active(void)
+{
+    return QspiTransfer.active;
+}
+
+void qspi_abort_asynch(void)
+{
+    if (!QspiTransfer.active)
+        return;
+
+    vIRQ_DisableIRQ(QUADSPI_IRQn);
+    qspi_finish();
+    qspi_abort();
+}
+
+const void *qspi_memory_map(const qspi_command_t *command)
+{
+    MBED_ASSERT(!QspiTransfer.active && (command->data_lines != QSPI_LINES_NONE));
+
+    qspi_idle();
+    // nCS stays low between accesses, no timeout
+    QUADSPI->CR &= ~QUADSPI_CR_TCEN;
+    qspi_start(command, QSPI_FMODE_MAPPED, 0);
+    QspiTransfer.mapped = 1;
+
+    return (const void *)QSPI_BASE;
+}
+
+void qspi_memory_unmap(void)
+{
+    if (!QspiTransfer.mapped)
+        return;
+
+    QspiTransfer.mapped = 0;
+    qspi_abort();
+}
+
+#endif
@@ -30,6 +30,7 @@
 #include "uvisor-lib/uvisor-lib.h"
 #include "mbed-drivers/mbed_assert.h"
 #include "serial_api.h"
+#include "serial_ext_api.h"
 
 #if DEVICE_SERIAL
 
@@ -40,6 +41,8 @@
 #include <string.h>
 #include "PeripheralPins.h"
 #include "target_config.h"
+#include "dma_channel.h"
+#include "uart_ring.h"
 
 #define DEBUG_STDIO 0
 
@@ -48,8 +51,8 @@
 #endif
 
 #if DEBUG_STDIO
-#   include <stdio.h>
-#   define DEBUG_PRINTF(...) do { printf(__VA_ARGS__); } while(0)
+#   include "debug_log.h"
+#   define DEBUG_PRINTF(...) do { debug_log_printf(__VA_ARGS__); } while(0)
 #else
 #   define DEBUG_PRINTF(...) {}
 #endif
@@ -83,10 +86,96 @@ static const IRQn_Type UartIRQs[UART_NUM] = {
 #endif
 };
 
+// Position of the kernel clock selection of each UART in RCC_CCIPR
+static const uint8_t UartClockSelShift[UART_NUM] = {0, 2, 4, 6, 8, 10};
+
 static uint32_t serial_irq_ids[UART_NUM] = {0, 0, 0, 0, 0, 0};
 static uart_irq_handler irq_handlers[UART_NUM] = {0, 0, 0, 0, 0, 0};
+static uint8_t tx_irq_enabled[UART_NUM] = {0, 0, 0, 0, 0, 0};
+// serial_putc() ran since the TxIrq handler was entered
+static volatile uint8_t tx_irq_written[UART_NUM] = {0, 0, 0, 0, 0, 0};
+
+typedef struct uart_dma {
+    int channel;        // claimed DMA channel, DMA_CHANNEL_NONE if none
+    uint8_t keep;       // keep the channel between transfers (DMA_USAGE_ALWAYS)
+    uint8_t active;     // a transfer is running on the channel
+    uint8_t circular;   // the channel wraps around the buffer (continuous reception)
+    uint32_t event;     // enabled STM32L4 specific events (serial_ext_api.h)
+} uart_dma_t;
+
+static uart_dma_t UartTxDma[UART_NUM];
+static uart_dma_t UartRxDma[UART_NUM];
+
+static const DMARequestName UartTxDmaRequests[UART_NUM] = {
+    DMA_REQ_USART1_TX,
+    DMA_REQ_USART2_TX,
+    DMA_REQ_USART3_TX,
+    DMA_REQ_UART4_TX,
+    DMA_REQ_UART5_TX,
+    DMA_REQ_LPUART1_TX,
+};
+
+typedef struct uart_buffered {
+    uart_ring_t rx;             // filled by the interrupt, drained by serial_read()
+    uart_ring_t tx;             // filled by serial_write(), drained by the interrupt
+    uint32_t rx_dropped;
+    uint8_t enabled;
+    uint8_t rx_throttled;       // RX ring full, RDR left unread so that RTS stops the sender
+} uart_buffered_t;
+
+static uart_buffered_t UartBuffered[UART_NUM];
+
+#define UART_TX_QUEUE_SIZE (4)
+
+// Scatter-gather transmission: segment lists queued by serial_tx_vector_asynch(),
+// the interrupt moves from one segment to the next without idle time on the line
+typedef struct uart_tx_vector {
+    const serial_iovec_t *iov[UART_TX_QUEUE_SIZE];
+    size_t iovcnt[UART_TX_QUEUE_SIZE];
+    uint8_t head;               // free running, next free slot
+    uint8_t tail;               // free running, list being sent
+    uint8_t active;
+    size_t segment;             // next segment of iov[tail]
+    size_t sent;                // items of the completed segments
+} uart_tx_vector_t;
+
+static uart_tx_vector_t UartTxVector[UART_NUM];
+
+// receiver timeout in bit durations, 0 if disabled
+static uint32_t UartRxTimeout[UART_NUM];
+
+// registers programmed by serial_baud()/serial_format()/serial_set_flow_control(),
+// only the changes are written
+typedef struct {
+    uint32_t brr;
+    uint32_t cr1;   // UART_CR1_FORMAT bits
+    uint32_t cr2;   // UART_CR2_FORMAT bits
+    uint32_t cr3;   // UART_CR3_FORMAT bits
+} uart_config_t;
+static uart_config_t UartConfig[UART_NUM];
+
+#define UART_CR1_FORMAT (USART_CR1_M | USART_CR1_PCE | USART_CR1_PS | USART_CR1_OVER8)
+#define UART_CR2_FORMAT (USART_CR2_STOP)
+#define UART_CR3_FORMAT (USART_CR3_RTSE | USART_CR3_CTSE)
+
+// largest baud rate error accepted by serial_baud(), in ppm
+#define UART_BAUD_ERROR_MAX (25000)
+
+// mute mode owns CR2.ADD, the character match is not available then
+static uint8_t UartMute[UART_NUM];
+
+static const DMARequestName UartRxDmaRequests[UART_NUM] = {
+    DMA_REQ_USART1_RX,
+    DMA_REQ_USART2_RX,
+    DMA_REQ_USART3_RX,
+    DMA_REQ_UART4_RX,
+    DMA_REQ_UART5_RX,
+    DMA_REQ_LPUART1_RX,
+};
 
 
+static void uart_config_save(uint8_t module);
+
 void serial_init(serial_t *obj, PinName tx, PinName rx)
 {
     // Determine the UART to use (UART_1, UART_2, ...)
@@ -168,6 +257,7 @@ void serial_init(serial_t *obj, PinName tx, PinName rx)
     }
 
     HAL_UART_Init(handle);
+    uart_config_save(obj->serial.module);
 
     // DEBUG_PRINTF("UART%u: Init\n", obj->serial.module+1);
 }
@@ -215,6 +305,16 @@ void serial_free(serial_t *obj)
             break;
 #endif
     }
+    // Give back the DMA channels
+    dma_channel_release(UartTxDma[obj->serial.module].channel);
+    dma_channel_release(UartRxDma[obj->serial.module].channel);
+    memset(&UartTxDma[obj->serial.module], 0, sizeof(uart_dma_t));
+    memset(&UartRxDma[obj->serial.module], 0, sizeof(uart_dma_t));
+    UartRxTimeout[obj->serial.module] = 0;
+    UartMute[obj->serial.module] = 0;
+    memset(&UartTxVector[obj->serial.module], 0, sizeof(uart_tx_vector_t));
+    tx_irq_enabled[obj->serial.module] = 0;
+
     // Configure GPIOs
     pin_function(obj->serial.pin_tx, STM_PIN_DATA(STM_MODE_INPUT, GPIO_NOPULL, 0));
     pin_function(obj->serial.pin_rx, STM_PIN_DATA(STM_MODE_INPUT, GPIO_NOPULL, 0));
@@ -222,18 +322,178 @@ void serial_free(serial_t *obj)
     DEBUG_PRINTF("UART%u: Free\n", obj->serial.module+1);
 }
 
+static uint32_t uart_clock_freq(uint8_t module)
+{
+    switch ((RCC->CCIPR >> UartClockSelShift[module]) & 0x3) {
+        case SerialClockSYSCLK:
+            return HAL_RCC_GetSysClockFreq();
+        case SerialClockHSI:
+            return HSI_VALUE;
+        case SerialClockLSE:
+            return LSE_VALUE;
+        default: // SerialClockPCLK
+            return (module == 0) ? HAL_RCC_GetPCLK2Freq() : HAL_RCC_GetPCLK1Freq();
+    }
+}
+
+static void uart_config_save(uint8_t module)
+{
+    USART_TypeDef *uart = UartHandle[module].Instance;
+
+    UartConfig[module].brr = uart->BRR;
+    UartConfig[module].cr1 = uart->CR1 & UART_CR1_FORMAT;
+    UartConfig[module].cr2 = uart->CR2 & UART_CR2_FORMAT;
+    UartConfig[module].cr3 = uart->CR3 & UART_CR3_FORMAT;
+}
+
+static uint32_t uart_brr(uint8_t module)
+{
+    UART_HandleTypeDef *handle = &UartHandle[module];
+    uint32_t clock = uart_clock_freq(module);
+    uint32_t baudrate = handle->Init.BaudRate;
+
+#if defined(LPUART1_BASE)
+    if ((UARTName)(handle->Instance) == LPUART_1) {
+        return (uint32_t)((((uint64_t)clock << 8) + (baudrate / 2)) / baudrate);
+    }
+#endif
+    if (handle->Init.OverSampling == UART_OVERSAMPLING_8) {
+        // BRR[2:0] holds USARTDIV[3:0] shifted right, BRR[3] must stay clear:
+        // USARTDIV = 2 * fck / baudrate is rounded to the nearest even value
+        uint32_t div = 2 * ((clock + (baudrate / 2)) / baudrate);
+        return (div & 0xFFF0) | ((div & 0x000F) >> 1);
+    }
+    return (clock + (baudrate / 2)) / baudrate;
+}
+
+// Program the baud rate, format and flow control of handle->Init without HAL_UART_Init:
+// only the registers that changed are written, UE is low for a few cycles and the
+// interrupt enables, DMA requests and handle state of pending transfers are kept.
+static void uart_config_apply(uint8_t module)
+{
+    UART_HandleTypeDef *handle = &UartHandle[module];
+    USART_TypeDef *uart = handle->Instance;
+    uart_config_t *config = &UartConfig[module];
+    uint32_t brr = uart_brr(module);
+    uint32_t cr1 = handle->Init.WordLength | handle->Init.Parity | handle->Init.OverSampling;
+    uint32_t cr2 = handle->Init.StopBits;
+    uint32_t cr3 = handle->Init.HwFlowCtl;
+
+    if ((brr == config->brr) && (cr1 == config->cr1) && (cr2 == config->cr2) && (cr3 == config->cr3))
+        return;
+
+    // a character being shifted out is lost, as with HAL_UART_Init
+    uint32_t ue = uart->CR1 & USART_CR1_UE;
+    uart->CR1 &= ~USART_CR1_UE;
+    if (brr != config->brr) {
+        uart->BRR = brr;
+    }
+    if (cr1 != config->cr1) {
+        uart->CR1 = (uart->CR1 & ~UART_CR1_FORMAT) | cr1;
+    }
+    if (cr2 != config->cr2) {
+        uart->CR2 = (uart->CR2 & ~UART_CR2_FORMAT) | cr2;
+    }
+    if (cr3 != config->cr3) {
+        uart->CR3 = (uart->CR3 & ~UART_CR3_FORMAT) | cr3;
+    }
+    uart->CR1 |= ue;
+
+    config->brr = brr;
+    config->cr1 = cr1;
+    config->cr2 = cr2;
+    config->cr3 = cr3;
+}
+
+// The UART runs at clock * numerator / divider baud
+static void uart_baud_ratio(uint8_t module, uint32_t *numerator, uint32_t *divider)
+{
+    USART_TypeDef *uart = UartHandle[module].Instance;
+    uint32_t brr = uart->BRR;
+
+#if defined(LPUART1_BASE)
+    if ((UARTName)uart == LPUART_1) {
+        *numerator = 256;
+        *divider = brr;
+        return;
+    }
+#endif
+    if (uart->CR1 & USART_CR1_OVER8) {
+        *numerator = 2;
+        *divider = (brr & 0xFFF0) | ((brr & 0x0007) << 1);
+    } else {
+        *numerator = 1;
+        *divider = brr;
+    }
+}
+
+int serial_baud_actual(serial_t *obj)
+{
+    uint32_t numerator, divider;
+
+    uart_baud_ratio(obj->serial.module, &numerator, &divider);
+    if (!divider)
+        return 0;
+
+    return (int)(((uint64_t)uart_clock_freq(obj->serial.module) * numerator + (divider / 2)) / divider);
+}
+
+int32_t serial_baud_error(serial_t *obj)
+{
+    UART_HandleTypeDef *handle = &UartHandle[obj->serial.module];
+    uint32_t numerator, divider;
+
+    uart_baud_ratio(obj->serial.module, &numerator, &divider);
+    if (!divider || !handle->Init.BaudRate)
+        return 0;
+
+    // exact ratio, the rounded actual rate is too coarse at low baud rates
+    int64_t rate = (int64_t)uart_clock_freq(obj->serial.module) * numerator * 1000000;
+    return (int32_t)((rate / ((int64_t)divider * handle->Init.BaudRate)) - 1000000);
+}
+
 void serial_baud(serial_t *obj, int baudrate)
 {
     UART_HandleTypeDef *handle = &UartHandle[obj->serial.module];
-    
-    if (((UARTName)(handle->Instance) == LPUART_1) && (baudrate < 38400)) {
-        error("The minimum baud rate is 38400 for LPUART_1 running at 80 MHz\n");
+    uint32_t clock = uart_clock_freq(obj->serial.module);
+
+    if (baudrate <= 0) {
+        error("UART%u: %d baud not supported\n", obj->serial.module+1, baudrate);
+    }
+
+#if defined(LPUART1_BASE)
+    if ((UARTName)(handle->Instance) == LPUART_1) {
+        // BRR = 256 * fck / baudrate must fit in [0x300, 0xFFFFF]
+        if (((uint64_t)baudrate * 3 > clock) || (((uint64_t)clock << 8) / baudrate > 0xFFFFF)) {
+            error("LPUART_1 cannot run at %d baud from a %u Hz clock\n", baudrate, clock);
+        }
+    } else
+#endif
+    {
+        // 16x oversampling tolerates more clock deviation, 8x reaches fck / 8
+        if ((uint64_t)baudrate * 16 <= clock) {
+            // BRR = fck / baudrate must fit in 16 bits
+            if ((clock + ((uint32_t)baudrate / 2)) / (uint32_t)baudrate > 0xFFFF) {
+                error("UART%u cannot run as slow as %d baud from a %u Hz clock\n", obj->serial.module+1, baudrate, clock);
+            }
+            handle->Init.OverSampling = UART_OVERSAMPLING_16;
+        } else if ((uint64_t)baudrate * 8 <= clock) {
+            handle->Init.OverSampling = UART_OVERSAMPLING_8;
+        } else {
+            error("UART%u cannot run at %d baud from a %u Hz clock\n", obj->serial.module+1, baudrate, clock);
+        }
     }
     handle->Init.BaudRate = baudrate;
 
-    HAL_UART_Init(handle);
+    uart_config_apply(obj->serial.module);
+
+    // beyond this the receivers miss bits, better fail now than with framing errors later
+    int32_t ppm = serial_baud_error(obj);
+    if ((ppm > UART_BAUD_ERROR_MAX) || (ppm < -UART_BAUD_ERROR_MAX)) {
+        error("UART%u: %d baud is off by %d ppm with a %u Hz clock\n", obj->serial.module+1, baudrate, ppm, clock);
+    }
 
-    DEBUG_PRINTF("UART%u: Baudrate: %u\n", obj->serial.module+1, baudrate);
+    DEBUG_PRINTF("UART%u: Baudrate: %u (%d ppm)\n", obj->serial.module+1, baudrate, ppm);
 }
 
 void serial_format(serial_t *obj, int data_bits, SerialParity parity, int stop_bits)
@@ -266,23 +526,278 @@ void serial_format(serial_t *obj, int data_bits, SerialParity parity, int stop_b
         handle->Init.StopBits = UART_STOPBITS_1;
     }
 
-    HAL_UART_Init(handle);
+    uart_config_apply(obj->serial.module);
 
     DEBUG_PRINTF("UART%u: Format: %u, %u, %u\n", obj->serial.module+1, data_bits, parity, stop_bits);
 }
 
+int serial_clock_source(serial_t *obj, SerialClockSource source)
+{
+    UART_HandleTypeDef *handle = &UartHandle[obj->serial.module];
+    RCC_OscInitTypeDef RCC_OscInitStruct = {0};
+    uint8_t shift = UartClockSelShift[obj->serial.module];
+
+    if ((source == SerialClockHSI) && (__HAL_RCC_GET_FLAG(RCC_FLAG_HSIRDY) == RESET)) {
+        RCC_OscInitStruct.OscillatorType      = RCC_OSCILLATORTYPE_HSI;
+        RCC_OscInitStruct.PLL.PLLState        = RCC_PLL_NONE; // Mandatory, otherwise the PLL is reconfigured!
+        RCC_OscInitStruct.HSIState            = RCC_HSI_ON;
+        RCC_OscInitStruct.HSICalibrationValue = RCC_HSICALIBRATION_DEFAULT;
+        if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK) {
+            return -1;
+        }
+    }
+
+    if ((source == SerialClockLSE) && (__HAL_RCC_GET_FLAG(RCC_FLAG_LSERDY) == RESET)) {
+        // LSE lives in the backup domain, shared with the RTC
+        __HAL_RCC_PWR_CLK_ENABLE();
+        HAL_PWR_EnableBkUpAccess();
+        RCC_OscInitStruct.OscillatorType = RCC_OSCILLATORTYPE_LSE;
+        RCC_OscInitStruct.PLL.PLLState   = RCC_PLL_NONE; // Mandatory, otherwise the PLL is reconfigured!
+        RCC_OscInitStruct.LSEState       = RCC_LSE_ON;
+        if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK) {
+            return -1;
+        }
+    }
+
+    // switch the kernel clock with the UART off, then BRR follows the new clock;
+    // the pending transfers keep their state as with serial_baud()
+    uint32_t ue = handle->Instance->CR1 & USART_CR1_UE;
+    handle->Instance->CR1 &= ~USART_CR1_UE;
+    RCC->CCIPR = (RCC->CCIPR & ~(0x3U << shift)) | ((uint32_t)source << shift);
+    uart_config_apply(obj->serial.module);
+    handle->Instance->CR1 |= ue;
+
+    DEBUG_PRINTF("UART%u: Clock: %u, %u Hz\n", obj->serial.module+1, source, uart_clock_freq(obj->serial.module));
+
+    return 0;
+}
+
+int serial_wakeup_from_stop(serial_t *obj, SerialWakeup wakeup, int enable)
+{
+    UART_HandleTypeDef *handle = &UartHandle[obj->serial.module];
+    USART_TypeDef *uart = handle->Instance;
+
+    if (!enable) {
+        uart->CR1 &= ~USART_CR1_UESM;
+        uart->CR3 &= ~USART_CR3_WUFIE;
+        return 0;
+    }
+
+    // only HSI and LSE can run the UART while the core is in STOP
+    uint32_t source = (RCC->CCIPR >> UartClockSelShift[obj->serial.module]) & 0x3;
+    if ((source != SerialClockHSI) && (source != SerialClockLSE)) {
+        return -1;
+    }
+
+    // WUS can only be written while the UART is disabled
+    __HAL_UART_DISABLE(handle);
+    uart->CR3 = (uart->CR3 & ~USART_CR3_WUS) | ((uint32_t)wakeup * USART_CR3_WUS_0);
+    __HAL_UART_ENABLE(handle);
+
+    // the wakeup flag goes through the UART interrupt, cleared by the handlers
+    __HAL_UART_CLEAR_FLAG(handle, USART_ICR_WUCF);
+    uart->CR3 |= USART_CR3_WUFIE;
+    uart->CR1 |= USART_CR1_UESM;
+
+    return 0;
+}
+
+#if DEVICE_SERIAL_FC
+int serial_rs485_enable(serial_t *obj, PinName de, int active_low, uint8_t assertion, uint8_t deassertion)
+{
+    UART_HandleTypeDef *handle = &UartHandle[obj->serial.module];
+    USART_TypeDef *uart = handle->Instance;
+
+    // DE is an alternate function of the RTS pin
+    if ((UARTName)pinmap_peripheral(de, PinMap_UART_RTS) != (UARTName)uart) {
+        return -1;
+    }
+    if ((assertion > 31) || (deassertion > 31)) {
+        return -1;
+    }
+    pinmap_pinout(de, PinMap_UART_RTS);
+
+    // DEM, DEP, DEAT and DEDT can only be written while the UART is disabled
+    __HAL_UART_DISABLE(handle);
+    handle->Init.HwFlowCtl &= ~UART_HWCONTROL_RTS;
+    UartConfig[obj->serial.module].cr3 &= ~USART_CR3_RTSE;
+    uart->CR3 = (uart->CR3 & ~(USART_CR3_RTSE | USART_CR3_DEP)) | USART_CR3_DEM | (active_low ? USART_CR3_DEP : 0);
+    uart->CR1 = (uart->CR1 & ~(USART_CR1_DEAT | USART_CR1_DEDT))
+              | ((uint32_t)assertion << UART_CR1_DEAT_ADDRESS_LSB_POS)
+              | ((uint32_t)deassertion << UART_CR1_DEDT_ADDRESS_LSB_POS);
+    __HAL_UART_ENABLE(handle);
+
+    DEBUG_PRINTF("UART%u: RS485: %u, %u, %u\n", obj->serial.module+1, active_low, assertion, deassertion);
+
+    return 0;
+}
+
+void serial_rs485_disable(serial_t *obj)
+{
+    UART_HandleTypeDef *handle = &UartHandle[obj->serial.module];
+
+    __HAL_UART_DISABLE(handle);
+    handle->Instance->CR3 &= ~(USART_CR3_DEM | USART_CR3_DEP);
+    __HAL_UART_ENABLE(handle);
+}
+#endif
+
+int serial_mute_enable(serial_t *obj, uint8_t address, uint8_t address_bits)
+{
+    UART_HandleTypeDef *handle = &UartHandle[obj->serial.module];
+    USART_TypeDef *uart = handle->Instance;
+
+    if ((address_bits != 4) && (address_bits != 7)) {
+        return -1;
+    }
+
+    // address mark wakeup: a character with its MSB set carries an address, compared
+    // against the 4 or 7 LSBs of ADD; the receiver sleeps through the other frames
+    // without setting RXNE, so no interrupt is taken for them
+    __HAL_UART_DISABLE(handle);
+    uart->CR2 = (uart->CR2 & ~(USART_CR2_ADD | USART_CR2_ADDM7))
+              | ((uint32_t)address << UART_CR2_ADDRESS_LSB_POS)
+              | ((address_bits == 7) ? USART_CR2_ADDM7 : 0);
+    uart->CR1 |= USART_CR1_MME | USART_CR1_WAKE;
+    __HAL_UART_ENABLE(handle);
+
+    UartMute[obj->serial.module] = 1;
+    serial_mute_enter(obj);
+
+    DEBUG_PRINTF("UART%u: Mute: %x/%u\n", obj->serial.module+1, address, address_bits);
+
+    return 0;
+}
+
+void serial_mute_enter(serial_t *obj)
+{
+    // left automatically when our address is received
+    __HAL_UART_SEND_REQ(&UartHandle[obj->serial.module], UART_MUTE_MODE_REQUEST);
+}
+
+void serial_mute_disable(serial_t *obj)
+{
+    UART_HandleTypeDef *handle = &UartHandle[obj->serial.module];
+
+    __HAL_UART_DISABLE(handle);
+    handle->Instance->CR1 &= ~(USART_CR1_MME | USART_CR1_WAKE);
+    __HAL_UART_ENABLE(handle);
+
+    UartMute[obj->serial.module] = 0;
+}
+
+#if DEVICE_SERIAL_FC
+void serial_set_flow_control(serial_t *obj, FlowControl type, PinName rxflow, PinName txflow)
+{
+    UART_HandleTypeDef *handle = &UartHandle[obj->serial.module];
+    UARTName instance = (UARTName)(handle->Instance);
+
+    // RTS deasserts as soon as RDR is full: an unread character throttles the sender,
+    // CTS holds TDR (and the DMA requests) until the receiver is ready
+    if (type == FlowControlNone) {
+        handle->Init.HwFlowCtl = UART_HWCONTROL_NONE;
+    }
+    if (type == FlowControlRTS) {
+        // Check if RTS pin matches
+        UARTName uart_rts = (UARTName)pinmap_peripheral(rxflow, PinMap_UART_RTS);
+        MBED_ASSERT(uart_rts == instance);
+        pinmap_pinout(rxflow, PinMap_UART_RTS);
+        handle->Init.HwFlowCtl = UART_HWCONTROL_RTS;
+    }
+    if (type == FlowControlCTS) {
+        // Check if CTS pin matches
+        UARTName uart_cts = (UARTName)pinmap_peripheral(txflow, PinMap_UART_CTS);
+        MBED_ASSERT(uart_cts == instance);
+        pinmap_pinout(txflow, PinMap_UART_CTS);
+        handle->Init.HwFlowCtl = UART_HWCONTROL_CTS;
+    }
+    if (type == FlowControlRTSCTS) {
+        // Check if RTS and CTS pins match
+        UARTName uart_rts = (UARTName)pinmap_peripheral(rxflow, PinMap_UART_RTS);
+        UARTName uart_cts = (UARTName)pinmap_peripheral(txflow, PinMap_UART_CTS);
+        MBED_ASSERT((uart_rts == instance) && (uart_cts == instance));
+        pinmap_pinout(rxflow, PinMap_UART_RTS);
+        pinmap_pinout(txflow, PinMap_UART_CTS);
+        handle->Init.HwFlowCtl = UART_HWCONTROL_RTS_CTS;
+    }
+
+    // RTSE/CTSE only change with UE low, the pending transfers keep their state
+    uart_config_apply(obj->serial.module);
+
+    DEBUG_PRINTF("UART%u: Flow control: %u\n", obj->serial.module+1, type);
+}
+#endif
+
 /******************************************************************************
  * INTERRUPTS HANDLING
  ******************************************************************************/
 
+static void uart_buffered_irq(uint8_t id)
+{
+    USART_TypeDef *uart = UartHandle[id].Instance;
+    uart_buffered_t *buffered = &UartBuffered[id];
+    uint32_t status = uart->ISR;
+
+    if (status & (USART_ISR_PE | USART_ISR_NE | USART_ISR_FE | USART_ISR_ORE | USART_ISR_WUF)) {
+        uart->ICR = USART_ICR_PECF | USART_ICR_FECF | USART_ICR_NCF | USART_ICR_ORECF | USART_ICR_WUCF;
+    }
+
+    if ((status & USART_ISR_RXNE) && buffered->rx.buffer) {
+        uart_ring_t *ring = &buffered->rx;
+        if ((uart_ring_space(ring) == 0) && (uart->CR3 & USART_CR3_RTSE)) {
+            // keep the byte in RDR: RTS stays deasserted until serial_read() makes room
+            uart->CR1 &= ~USART_CR1_RXNEIE;
+            buffered->rx_throttled = 1;
+        } else if (!uart_ring_put(ring, (uint8_t)uart->RDR)) {
+            // no flow control, the byte is lost
+            buffered->rx_dropped++;
+        }
+    }
+
+    if ((status & USART_ISR_TXE) && (uart->CR1 & USART_CR1_TXEIE)) {
+        uart_ring_t *ring = &buffered->tx;
+        uint8_t data;
+        if (uart_ring_get(ring, &data)) {
+            uart->TDR = data;
+        } else {
+            uart->CR1 &= ~USART_CR1_TXEIE;
+            // serial_write() may have queued data just before TXEIE got cleared
+            if (ring->tail != ring->head) {
+                uart->CR1 |= USART_CR1_TXEIE;
+            }
+        }
+    }
+}
+
 static void uart_irq(uint8_t id)
 {
     UART_HandleTypeDef *handle = &UartHandle[id];
 
+    if (UartBuffered[id].enabled) {
+        uart_buffered_irq(id);
+        return;
+    }
+
+    if (__HAL_UART_GET_FLAG(handle, USART_ISR_WUF) != RESET) {
+        __HAL_UART_CLEAR_FLAG(handle, USART_ICR_WUCF);
+    }
+
     if (serial_irq_ids[id] != 0) {
-        if (__HAL_UART_GET_FLAG(handle, UART_FLAG_TC) != RESET && handle->Instance != UART_1) {     //DIRTY HACK!!! DISABLE Tx Interrupt on UART1
+        uint32_t cr1 = handle->Instance->CR1;
+        if ((cr1 & USART_CR1_TXEIE) && (__HAL_UART_GET_FLAG(handle, UART_FLAG_TXE) != RESET)) {
+            // room in TDR for the next byte
+            tx_irq_written[id] = 0;
+            irq_handlers[id](serial_irq_ids[id], TxIrq);
+            // TXE alone can't tell: it reads set again right after a write when the shifter is idle
+            if (!tx_irq_written[id] && tx_irq_enabled[id] && (handle->Instance->CR1 & USART_CR1_TXEIE)) {
+                // nothing was written: stay quiet until the last byte is out
+                handle->Instance->CR1 = (handle->Instance->CR1 & ~USART_CR1_TXEIE) | USART_CR1_TCIE;
+            }
+        } else if ((cr1 & USART_CR1_TCIE) && (__HAL_UART_GET_FLAG(handle, UART_FLAG_TC) != RESET)) {
+            // transmission complete, reported once; serial_putc() restarts the TXE interrupts
+            handle->Instance->CR1 &= ~USART_CR1_TCIE;
+            __HAL_UART_CLEAR_FLAG(handle, UART_CLEAR_TCF);
             irq_handlers[id](serial_irq_ids[id], TxIrq);
-            __HAL_UART_CLEAR_FLAG(handle, UART_FLAG_TC);
         }
         if (__HAL_UART_GET_FLAG(handle, UART_FLAG_RXNE) != RESET) {
             irq_handlers[id](serial_irq_ids[id], RxIrq);
@@ -329,26 +844,26 @@ static void lpuart1_irq(void)
 }
 #endif
 
-static const uint32_t uart_irq_vectors[UART_NUM] = {
-    (uint32_t)&uart1_irq,
-    (uint32_t)&uart2_irq,
+static void (* const uart_irq_vectors[UART_NUM])(void) = {
+    &uart1_irq,
+    &uart2_irq,
 #if defined(USART3_BASE)
-    (uint32_t)&uart3_irq,
+    &uart3_irq,
 #else
     0,
 #endif
 #if defined(UART4_BASE)
-    (uint32_t)&uart4_irq,
+    &uart4_irq,
 #else
     0,
 #endif
 #if defined(UART5_BASE)
-    (uint32_t)&uart5_irq,
+    &uart5_irq,
 #else
     0,
 #endif
 #if defined(LPUART1_BASE)
-    (uint32_t)&lpuart1_irq,
+    &lpuart1_irq,
 #else
     0,
 #endif
@@ -364,7 +879,7 @@ void serial_irq_set(serial_t *obj, SerialIrq irq, uint32_t enable)
 {
     UART_HandleTypeDef *handle = &UartHandle[obj->serial.module];
     IRQn_Type irq_n = UartIRQs[obj->serial.module];
-    uint32_t vector = uart_irq_vectors[obj->serial.module];
+    uint32_t vector = (uint32_t)uart_irq_vectors[obj->serial.module];
 
     if (!irq_n || !vector)
         return;
@@ -374,7 +889,10 @@ void serial_irq_set(serial_t *obj, SerialIrq irq, uint32_t enable)
         if (irq == RxIrq) {
             __HAL_UART_ENABLE_IT(handle, UART_IT_RXNE);
         } else { // TxIrq
-            __HAL_UART_ENABLE_IT(handle, UART_IT_TC);
+            // TXE while data flows, TC only once TDR stays empty
+            tx_irq_enabled[obj->serial.module] = 1;
+            __HAL_UART_DISABLE_IT(handle, UART_IT_TC);
+            __HAL_UART_ENABLE_IT(handle, UART_IT_TXE);
         }
 
         vIRQ_SetVector(irq_n, vector);
@@ -387,9 +905,11 @@ void serial_irq_set(serial_t *obj, SerialIrq irq, uint32_t enable)
         if (irq == RxIrq) {
             __HAL_UART_DISABLE_IT(handle, UART_IT_RXNE);
             // Check if TxIrq is disabled too
-            if ((handle->Instance->CR1 & USART_CR1_TXEIE) == 0) all_disabled = 1;
+            if (!tx_irq_enabled[obj->serial.module]) all_disabled = 1;
         } else { // TxIrq
+            tx_irq_enabled[obj->serial.module] = 0;
             __HAL_UART_DISABLE_IT(handle, UART_IT_TXE);
+            __HAL_UART_DISABLE_IT(handle, UART_IT_TC);
             // Check if RxIrq is disabled too
             if ((handle->Instance->CR1 & USART_CR1_RXNEIE) == 0) all_disabled = 1;
         }
@@ -399,6 +919,108 @@ void serial_irq_set(serial_t *obj, SerialIrq irq, uint32_t enable)
     }
 }
 
+/******************************************************************************
+ * BUFFERED MODE
+ ******************************************************************************/
+
+int serial_buffered_enable(serial_t *obj, void *rx_buffer, size_t rx_size, void *tx_buffer, size_t tx_size)
+{
+    UART_HandleTypeDef *handle = &UartHandle[obj->serial.module];
+    uart_buffered_t *buffered = &UartBuffered[obj->serial.module];
+    IRQn_Type irq_n = UartIRQs[obj->serial.module];
+    uint32_t vector = (uint32_t)uart_irq_vectors[obj->serial.module];
+
+    if (!irq_n || !vector)
+        return -1;
+
+    buffered->enabled = 0;
+    handle->Instance->CR1 &= ~(USART_CR1_RXNEIE | USART_CR1_TXEIE | USART_CR1_TCIE);
+
+    if (uart_ring_init(&buffered->rx, rx_buffer, rx_size) || uart_ring_init(&buffered->tx, tx_buffer, tx_size)) {
+        return -1;
+    }
+    buffered->rx_dropped = 0;
+    buffered->rx_throttled = 0;
+    buffered->enabled = 1;
+
+    vIRQ_SetVector(irq_n, vector);
+    if (buffered->rx.buffer) {
+        __HAL_UART_CLEAR_FLAG(handle, USART_ICR_PECF | USART_ICR_FECF | USART_ICR_NCF | USART_ICR_ORECF);
+        handle->Instance->CR1 |= USART_CR1_RXNEIE;
+        handle->Instance->CR3 |= USART_CR3_EIE;
+    }
+    vIRQ_EnableIRQ(irq_n);
+
+    DEBUG_PRINTF("UART%u: Buffered: %u, %u\n", obj->serial.module+1, rx_size, tx_size);
+
+    return 0;
+}
+
+void serial_buffered_disable(serial_t *obj)
+{
+    UART_HandleTypeDef *handle = &UartHandle[obj->serial.module];
+    uart_buffered_t *buffered = &UartBuffered[obj->serial.module];
+
+    if (!buffered->enabled)
+        return;
+
+    handle->Instance->CR1 &= ~(USART_CR1_RXNEIE | USART_CR1_TXEIE);
+    handle->Instance->CR3 &= ~USART_CR3_EIE;
+    buffered->enabled = 0;
+    vIRQ_DisableIRQ(UartIRQs[obj->serial.module]);
+}
+
+size_t serial_read(serial_t *obj, void *buffer, size_t length)
+{
+    uart_ring_t *ring = &UartBuffered[obj->serial.module].rx;
+
+    if (!UartBuffered[obj->serial.module].enabled || ring->buffer == NULL)
+        return 0;
+
+    length = uart_ring_read(ring, buffer, length);
+
+    if (UartBuffered[obj->serial.module].rx_throttled && length) {
+        // room again, let the interrupt pick up the byte waiting in RDR
+        UartBuffered[obj->serial.module].rx_throttled = 0;
+        UartHandle[obj->serial.module].Instance->CR1 |= USART_CR1_RXNEIE;
+    }
+
+    return length;
+}
+
+size_t serial_write(serial_t *obj, const void *buffer, size_t length)
+{
+    UART_HandleTypeDef *handle = &UartHandle[obj->serial.module];
+    uart_ring_t *ring = &UartBuffered[obj->serial.module].tx;
+
+    if (!UartBuffered[obj->serial.module].enabled || ring->buffer == NULL)
+        return 0;
+
+    length = uart_ring_write(ring, buffer, length);
+    if (length == 0)
+        return 0;
+
+    // the interrupt fires right away if TDR is empty
+    handle->Instance->CR1 |= USART_CR1_TXEIE;
+
+    return length;
+}
+
+size_t serial_write_space(serial_t *obj)
+{
+    uart_ring_t *ring = &UartBuffered[obj->serial.module].tx;
+
+    if (!UartBuffered[obj->serial.module].enabled || ring->buffer == NULL)
+        return 0;
+
+    return uart_ring_space(ring);
+}
+
+uint32_t serial_rx_dropped(serial_t *obj)
+{
+    return UartBuffered[obj->serial.module].rx_dropped;
+}
+
 /******************************************************************************
  * READ/WRITE
  ******************************************************************************/
@@ -415,6 +1037,11 @@ void serial_putc(serial_t *obj, int c)
     UART_HandleTypeDef *handle = &UartHandle[obj->serial.module];
     while (!serial_writable(obj));
     handle->Instance->TDR = (uint32_t)(c & (uint32_t)0xFF);
+    tx_irq_written[obj->serial.module] = 1;
+    if (tx_irq_enabled[obj->serial.module]) {
+        // back from TC to TXE interrupts
+        handle->Instance->CR1 = (handle->Instance->CR1 & ~USART_CR1_TCIE) | USART_CR1_TXEIE;
+    }
 }
 
 int serial_readable(serial_t *obj)
@@ -458,11 +1085,72 @@ void serial_break_clear(serial_t *obj)
     (void)obj;
 }
 
-int serial_tx_asynch(serial_t *obj, void *tx, size_t tx_length, uint8_t tx_width, uint32_t handler, uint32_t event, DMAUsage hint)
+static int uart_tx_dma_start(serial_t *obj, void *tx, size_t tx_length, uint8_t tx_width, uint32_t handler, DMAUsage hint)
 {
-    // TODO: DMA usage is currently ignored
-    (void) hint;
+    UART_HandleTypeDef *handle = &UartHandle[obj->serial.module];
+    uart_dma_t *dma = &UartTxDma[obj->serial.module];
+
+    if (hint == DMA_USAGE_NEVER || tx_length > 0xFFFF)
+        return 0;
+
+    if (dma->channel == DMA_CHANNEL_NONE) {
+        dma->channel = dma_channel_claim(UartTxDmaRequests[obj->serial.module]);
+        if (dma->channel == DMA_CHANNEL_NONE) {
+            // no free channel, the caller falls back to the interrupt path
+            return 0;
+        }
+        dma->keep = (hint == DMA_USAGE_ALWAYS);
+    }
+
+    uint32_t ccr = DMA_CCR_DIR | DMA_CCR_MINC;
+    if (tx_width == 16) {
+        ccr |= DMA_CCR_MSIZE_0 | DMA_CCR_PSIZE_0;
+    }
+
+    if (UartTxVector[obj->serial.module].active) {
+        // the channel interrupt chains the next segment
+        IRQn_Type dma_irq_n = dma_channel_irq(dma->channel);
+        vIRQ_SetVector(dma_irq_n, handler);
+        vIRQ_EnableIRQ(dma_irq_n);
+        ccr |= DMA_CCR_TCIE;
+    }
+
+    handle->pTxBuffPtr = tx;
+    handle->TxXferSize = tx_length;
+    handle->TxXferCount = tx_length;
+    dma->active = 1;
+
+    // TC must be cleared before the channel is enabled, it is then set only
+    // once the last data has left the shift register: no interrupt per byte
+    __HAL_UART_CLEAR_FLAG(handle, UART_CLEAR_TCF);
+    dma_channel_start(dma->channel, ccr, &handle->Instance->TDR, tx, tx_length);
+    handle->Instance->CR3 |= USART_CR3_DMAT;
+    handle->Instance->CR1 |= USART_CR1_TCIE;
+
+    return 1;
+}
+
+static void uart_tx_dma_stop(serial_t *obj)
+{
+    UART_HandleTypeDef *handle = &UartHandle[obj->serial.module];
+    uart_dma_t *dma = &UartTxDma[obj->serial.module];
+
+    if (!dma->active)
+        return;
+
+    handle->Instance->CR3 &= ~USART_CR3_DMAT;
+    dma->active = 0;
 
+    if (dma->keep) {
+        dma_channel_stop(dma->channel);
+    } else {
+        dma_channel_release(dma->channel);
+        dma->channel = DMA_CHANNEL_NONE;
+    }
+}
+
+int serial_tx_asynch(serial_t *obj, void *tx, size_t tx_length, uint8_t tx_width, uint32_t handler, uint32_t event, DMAUsage hint)
+{
     bool use_tx = (tx != NULL && tx_length > 0);
     IRQn_Type irq_n = UartIRQs[obj->serial.module];
 
@@ -481,12 +1169,6 @@ int serial_tx_asynch(serial_t *obj, void *tx, size_t tx_length, uint8_t tx_width
     vIRQ_EnableIRQ(irq_n);
 
     UART_HandleTypeDef *handle = &UartHandle[obj->serial.module];
-    // HAL_StatusTypeDef rc = HAL_UART_Transmit_IT(handle, tx, tx_length);
-
-    // manually implemented HAL_UART_Transmit_IT for tighter control of what it does
-    handle->pTxBuffPtr = tx;
-    handle->TxXferSize = tx_length;
-    handle->TxXferCount = tx_length;
 
     if(handle->State == HAL_UART_STATE_BUSY_RX) {
         handle->State = HAL_UART_STATE_BUSY_TX_RX;
@@ -494,10 +1176,23 @@ int serial_tx_asynch(serial_t *obj, void *tx, size_t tx_length, uint8_t tx_width
         handle->State = HAL_UART_STATE_BUSY_TX;
     }
 
+    if (uart_tx_dma_start(obj, tx, tx_length, tx_width, handler, hint)) {
+        DEBUG_PRINTF("UART%u: Tx DMA: 0=(%u, %u) %x\n", obj->serial.module+1, tx_length, tx_width, HAL_UART_GetState(handle));
+        return tx_length;
+    }
+
+    // HAL_StatusTypeDef rc = HAL_UART_Transmit_IT(handle, tx, tx_length);
+
+    // manually implemented HAL_UART_Transmit_IT for tighter control of what it does
+    handle->pTxBuffPtr = tx;
+    handle->TxXferSize = tx_length;
+    handle->TxXferCount = tx_length;
+
     // if the TX register is empty, directly input the first transmit byte
     if (__HAL_UART_GET_FLAG(handle, UART_FLAG_TXE)) {
         handle->Instance->TDR = *handle->pTxBuffPtr++;
         handle->TxXferCount--;
+        obj->tx_buff.pos++;
     }
     // chose either the tx reg empty or if last byte wait directly for tx complete
     if (handle->TxXferCount != 0) {
@@ -511,11 +1206,251 @@ int serial_tx_asynch(serial_t *obj, void *tx, size_t tx_length, uint8_t tx_width
     return tx_length;
 }
 
-void serial_rx_asynch(serial_t *obj, void *rx, size_t rx_length, uint8_t rx_width, uint32_t handler, uint32_t event, uint8_t char_match, DMAUsage hint)
+// Load the next non empty segment of the queued lists into the handle
+static int uart_tx_vector_load(serial_t *obj)
+{
+    UART_HandleTypeDef *handle = &UartHandle[obj->serial.module];
+    uart_tx_vector_t *vector = &UartTxVector[obj->serial.module];
+
+    while (vector->tail != vector->head) {
+        uint8_t slot = vector->tail % UART_TX_QUEUE_SIZE;
+        if (vector->segment < vector->iovcnt[slot]) {
+            const serial_iovec_t *iov = &vector->iov[slot][vector->segment++];
+            if (iov->length) {
+                handle->pTxBuffPtr = (uint8_t *)iov->buffer;
+                handle->TxXferSize = iov->length;
+                handle->TxXferCount = iov->length;
+                return 1;
+            }
+        } else {
+            vector->tail++;
+            vector->segment = 0;
+        }
+    }
+    return 0;
+}
+
+// The current segment is out (IRQ) or handed to TDR (DMA), continue with the next one
+static int uart_tx_vector_next(serial_t *obj)
+{
+    UART_HandleTypeDef *handle = &UartHandle[obj->serial.module];
+    uart_tx_vector_t *vector = &UartTxVector[obj->serial.module];
+    uart_dma_t *dma = &UartTxDma[obj->serial.module];
+
+    if (!vector->active)
+        return 0;
+
+    vector->sent += handle->TxXferSize;
+    handle->TxXferSize = 0;
+
+    if (!uart_tx_vector_load(obj))
+        return 0;
+
+    if (dma->active) {
+        uint32_t ccr = DMA_CCR_DIR | DMA_CCR_MINC | DMA_CCR_TCIE;
+        if (obj->tx_buff.width == 16) {
+            ccr |= DMA_CCR_MSIZE_0 | DMA_CCR_PSIZE_0;
+        }
+        // TXE keeps requesting, the channel refills TDR as soon as it is enabled
+        dma_channel_start(dma->channel, ccr, &handle->Instance->TDR, handle->pTxBuffPtr, handle->TxXferCount);
+    }
+    return 1;
+}
+
+int serial_tx_vector_asynch(serial_t *obj, const serial_iovec_t *iov, size_t iovcnt, uint8_t tx_width, uint32_t handler, uint32_t event, DMAUsage hint)
+{
+    UART_HandleTypeDef *handle = &UartHandle[obj->serial.module];
+    uart_tx_vector_t *vector = &UartTxVector[obj->serial.module];
+    IRQn_Type irq_n = UartIRQs[obj->serial.module];
+    size_t length = 0;
+
+    if (iov == NULL || !irq_n)
+        return 0;
+
+    for (size_t i = 0; i < iovcnt; i++) {
+        if (iov[i].length > 0xFFFF)
+            return 0;
+        length += iov[i].length;
+    }
+    if (!length)
+        return 0;
+
+    // the interrupt may be finishing the previous lists
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if ((uint8_t)(vector->head - vector->tail) >= UART_TX_QUEUE_SIZE) {
+        __set_PRIMASK(primask);
+        return 0;
+    }
+    vector->iov[vector->head % UART_TX_QUEUE_SIZE] = iov;
+    vector->iovcnt[vector->head % UART_TX_QUEUE_SIZE] = iovcnt;
+    vector->head++;
+
+    if (vector->active) {
+        // sent right behind the running lists
+        obj->tx_buff.length += length;
+        __set_PRIMASK(primask);
+        return length;
+    }
+
+    obj->tx_buff.buffer = (void *)iov[0].buffer;
+    obj->tx_buff.length = length;
+    obj->tx_buff.pos    = 0;
+    obj->tx_buff.width  = tx_width;
+
+    obj->serial.event   = (obj->serial.event & ~SERIAL_EVENT_TX_MASK) | (event & SERIAL_EVENT_TX_MASK);
+
+    // register the thunking handler
+    vIRQ_SetVector(irq_n, handler);
+    vIRQ_EnableIRQ(irq_n);
+
+    if(handle->State == HAL_UART_STATE_BUSY_RX) {
+        handle->State = HAL_UART_STATE_BUSY_TX_RX;
+    } else {
+        handle->State = HAL_UART_STATE_BUSY_TX;
+    }
+
+    vector->active  = 1;
+    vector->segment = 0;
+    vector->sent    = 0;
+    uart_tx_vector_load(obj);
+
+    if (!uart_tx_dma_start(obj, handle->pTxBuffPtr, handle->TxXferCount, tx_width, handler, hint)) {
+        // the TXE interrupt writes the first item and moves across the segments
+        handle->Instance->CR1 |= USART_CR1_TXEIE;
+    }
+
+    __set_PRIMASK(primask);
+
+    DEBUG_PRINTF("UART%u: Tx vector: 0=(%u, %u, %u) %x\n", obj->serial.module+1, iovcnt, length, tx_width, HAL_UART_GetState(handle));
+
+    return length;
+}
+
+static void uart_rx_dma_stop(serial_t *obj)
+{
+    UART_HandleTypeDef *handle = &UartHandle[obj->serial.module];
+    uart_dma_t *dma = &UartRxDma[obj->serial.module];
+
+    if (!dma->active)
+        return;
+
+    handle->Instance->CR3 &= ~USART_CR3_DMAR;
+    handle->Instance->CR1 &= ~USART_CR1_IDLEIE;
+    vIRQ_DisableIRQ(dma_channel_irq(dma->channel));
+    dma->active = 0;
+    dma->circular = 0;
+    dma->event = 0;
+
+    if (dma->keep) {
+        dma_channel_stop(dma->channel);
+    } else {
+        dma_channel_release(dma->channel);
+        dma->channel = DMA_CHANNEL_NONE;
+    }
+}
+
+static void uart_rx_finish(serial_t *obj)
 {
-    // TODO: DMA usage is currently ignored
-    (void) hint;
+    UART_HandleTypeDef *handle = &UartHandle[obj->serial.module];
+    // disable all rx interrupts
+    handle->Instance->CR1 &= ~(USART_CR1_RXNEIE | USART_CR1_PEIE | USART_CR1_CMIE | USART_CR1_RTOIE);
+    handle->Instance->CR3 &= ~USART_CR3_EIE;
+    // stop the DMA channel, if any
+    uart_rx_dma_stop(obj);
+    // reset states
+    handle->RxXferCount = 0;
+    // update handle state
+    if(handle->State == HAL_UART_STATE_BUSY_TX_RX) {
+        handle->State = HAL_UART_STATE_BUSY_TX;
+    } else {
+        handle->State = HAL_UART_STATE_READY;
+    }
+}
+
+static int uart_rx_dma_start(serial_t *obj, void *rx, size_t rx_length, uint8_t rx_width, uint32_t handler, DMAUsage hint)
+{
+    UART_HandleTypeDef *handle = &UartHandle[obj->serial.module];
+    uart_dma_t *dma = &UartRxDma[obj->serial.module];
 
+    if (hint == DMA_USAGE_NEVER || rx_length > 0xFFFF)
+        return 0;
+
+    if (dma->channel == DMA_CHANNEL_NONE) {
+        dma->channel = dma_channel_claim(UartRxDmaRequests[obj->serial.module]);
+        if (dma->channel == DMA_CHANNEL_NONE) {
+            // no free channel, the caller falls back to the interrupt path
+            return 0;
+        }
+        dma->keep = (hint == DMA_USAGE_ALWAYS);
+    }
+
+    uint32_t ccr = DMA_CCR_MINC | DMA_CCR_TCIE;
+    if (rx_width == 16) {
+        ccr |= DMA_CCR_MSIZE_0 | DMA_CCR_PSIZE_0;
+    }
+
+    handle->pRxBuffPtr = rx;
+    handle->RxXferSize = rx_length;
+    // the byte per byte path stays idle
+    handle->RxXferCount = 0;
+    dma->active = 1;
+    dma->circular = 0;
+
+    // the channel interrupt reports the end of the reception
+    IRQn_Type dma_irq_n = dma_channel_irq(dma->channel);
+    vIRQ_SetVector(dma_irq_n, handler);
+    vIRQ_EnableIRQ(dma_irq_n);
+
+    dma_channel_start(dma->channel, ccr, &handle->Instance->RDR, rx, rx_length);
+    handle->Instance->CR3 |= USART_CR3_DMAR;
+
+    return 1;
+}
+
+static void uart_set_match_address(UART_HandleTypeDef *handle, uint8_t address)
+{
+    USART_TypeDef *uart = handle->Instance;
+
+    if (((uart->CR2 & USART_CR2_ADD) >> UART_CR2_ADDRESS_LSB_POS) == address)
+        return;
+
+    // ADD can only be written while the receiver is disabled
+    uint32_t re = uart->CR1 & USART_CR1_RE;
+    uart->CR1 &= ~USART_CR1_RE;
+    uart->CR2 = (uart->CR2 & ~USART_CR2_ADD) | ((uint32_t)address << UART_CR2_ADDRESS_LSB_POS);
+    uart->CR1 |= re;
+}
+
+int serial_rx_timeout(serial_t *obj, uint32_t bit_times)
+{
+    UART_HandleTypeDef *handle = &UartHandle[obj->serial.module];
+
+#if defined(LPUART1_BASE)
+    if ((UARTName)(handle->Instance) == LPUART_1)
+        return -1;
+#endif
+
+    if (bit_times > USART_RTOR_RTO)
+        bit_times = USART_RTOR_RTO;
+
+    UartRxTimeout[obj->serial.module] = bit_times;
+
+    // RTOR can be written on the fly
+    handle->Instance->RTOR = (handle->Instance->RTOR & ~USART_RTOR_RTO) | bit_times;
+    if (bit_times) {
+        handle->Instance->CR2 |= USART_CR2_RTOEN;
+    } else {
+        handle->Instance->CR2 &= ~USART_CR2_RTOEN;
+        handle->Instance->CR1 &= ~USART_CR1_RTOIE;
+    }
+
+    return 0;
+}
+
+void serial_rx_asynch(serial_t *obj, void *rx, size_t rx_length, uint8_t rx_width, uint32_t handler, uint32_t event, uint8_t char_match, DMAUsage hint)
+{
     bool use_rx = (rx != NULL && rx_length > 0);
     IRQn_Type irq_n = UartIRQs[obj->serial.module];
 
@@ -527,7 +1462,9 @@ void serial_rx_asynch(serial_t *obj, void *rx, size_t rx_length, uint8_t rx_widt
     obj->rx_buff.pos    = 0;
     obj->rx_buff.width  = rx_width;
 
-    obj->serial.event      = (obj->serial.event & ~SERIAL_EVENT_RX_MASK) | (event & SERIAL_EVENT_RX_MASK);
+    // SERIAL_EVENT_RX_TIMEOUT is kept next to the generic RX events
+    obj->serial.event      = (obj->serial.event & ~(SERIAL_EVENT_RX_MASK | SERIAL_EVENT_RX_TIMEOUT))
+                           | (event & (SERIAL_EVENT_RX_MASK | SERIAL_EVENT_RX_TIMEOUT));
     obj->serial.char_match = char_match;
 
     UART_HandleTypeDef *handle = &UartHandle[obj->serial.module];
@@ -535,11 +1472,19 @@ void serial_rx_asynch(serial_t *obj, void *rx, size_t rx_length, uint8_t rx_widt
     vIRQ_SetVector(irq_n, handler);
     vIRQ_EnableIRQ(irq_n);
 
-    // HAL_StatusTypeDef rc = HAL_UART_Receive_IT(handle, rx, rx_length);
+    // the character match is detected by the USART itself (CMF)
+    uint32_t cr1 = USART_CR1_PEIE;
+    if ((char_match != SERIAL_RESERVED_CHAR_MATCH) && !UartMute[obj->serial.module]) {
+        uart_set_match_address(handle, char_match);
+        __HAL_UART_CLEAR_FLAG(handle, USART_ICR_CMCF);
+        cr1 |= USART_CR1_CMIE;
+    }
 
-    handle->pRxBuffPtr = rx;
-    handle->RxXferSize = rx_length;
-    handle->RxXferCount = rx_length;
+    // the end of the frame is detected by the receiver timeout
+    if (UartRxTimeout[obj->serial.module]) {
+        __HAL_UART_CLEAR_FLAG(handle, USART_ICR_RTOCF);
+        cr1 |= USART_CR1_RTOIE;
+    }
 
     if(handle->State == HAL_UART_STATE_BUSY_TX) {
         handle->State = HAL_UART_STATE_BUSY_TX_RX;
@@ -548,19 +1493,114 @@ void serial_rx_asynch(serial_t *obj, void *rx, size_t rx_length, uint8_t rx_widt
     }
 
     __HAL_UART_CLEAR_PEFLAG(handle);
-    handle->Instance->CR1 |= USART_CR1_RXNEIE | USART_CR1_PEIE;
+
+    if (!uart_rx_dma_start(obj, rx, rx_length, rx_width, handler, hint)) {
+        // HAL_StatusTypeDef rc = HAL_UART_Receive_IT(handle, rx, rx_length);
+        handle->pRxBuffPtr = rx;
+        handle->RxXferSize = rx_length;
+        handle->RxXferCount = rx_length;
+        cr1 |= USART_CR1_RXNEIE;
+    }
+
+    handle->Instance->CR1 |= cr1;
     handle->Instance->CR3 |= USART_CR3_EIE;
 
     DEBUG_PRINTF("UART%u: Rx: 0=(%u, %u, %u) %x\n", obj->serial.module+1, rx_length, rx_width, char_match, HAL_UART_GetState(handle));
 }
 
+int serial_rx_circular_asynch(serial_t *obj, void *rx, size_t rx_length, uint8_t rx_width, uint32_t handler, uint32_t event)
+{
+    UART_HandleTypeDef *handle = &UartHandle[obj->serial.module];
+    uart_dma_t *dma = &UartRxDma[obj->serial.module];
+    IRQn_Type irq_n = UartIRQs[obj->serial.module];
+
+    if (rx == NULL || rx_length == 0 || rx_length > 0xFFFF || !irq_n)
+        return -1;
+
+    if (dma->channel == DMA_CHANNEL_NONE) {
+        dma->channel = dma_channel_claim(UartRxDmaRequests[obj->serial.module]);
+        if (dma->channel == DMA_CHANNEL_NONE)
+            return -1;
+        dma->keep = 0;
+    }
+
+    obj->rx_buff.buffer = rx;
+    obj->rx_buff.length = rx_length;
+    obj->rx_buff.pos    = 0;
+    obj->rx_buff.width  = rx_width;
+
+    obj->serial.event      = (obj->serial.event & ~(SERIAL_EVENT_RX_MASK | SERIAL_EVENT_RX_TIMEOUT))
+                           | (event & SERIAL_EVENT_RX_MASK);
+    obj->serial.char_match = SERIAL_RESERVED_CHAR_MATCH;
+
+    dma->active   = 1;
+    dma->circular = 1;
+    dma->event    = event & (SERIAL_EVENT_RX_HALF_FULL | SERIAL_EVENT_RX_FULL | SERIAL_EVENT_RX_IDLE);
+
+    // the byte per byte path stays idle
+    handle->pRxBuffPtr = rx;
+    handle->RxXferSize = rx_length;
+    handle->RxXferCount = 0;
+
+    if(handle->State == HAL_UART_STATE_BUSY_TX) {
+        handle->State = HAL_UART_STATE_BUSY_TX_RX;
+    } else {
+        handle->State = HAL_UART_STATE_BUSY_RX;
+    }
+
+    // register the thunking handler for both the UART (idle, errors) and the channel (half/full)
+    IRQn_Type dma_irq_n = dma_channel_irq(dma->channel);
+    vIRQ_SetVector(irq_n, handler);
+    vIRQ_EnableIRQ(irq_n);
+    vIRQ_SetVector(dma_irq_n, handler);
+    vIRQ_EnableIRQ(dma_irq_n);
+
+    uint32_t ccr = DMA_CCR_CIRC | DMA_CCR_MINC | DMA_CCR_HTIE | DMA_CCR_TCIE;
+    if (rx_width == 16) {
+        ccr |= DMA_CCR_MSIZE_0 | DMA_CCR_PSIZE_0;
+    }
+
+    // drop whatever was received before, unless RTS held it back for us
+    if (!(handle->Instance->CR3 & USART_CR3_RTSE)) {
+        handle->Instance->RQR = USART_RQR_RXFRQ;
+    }
+    __HAL_UART_CLEAR_FLAG(handle, USART_ICR_IDLECF | USART_ICR_PECF | USART_ICR_FECF | USART_ICR_NCF | USART_ICR_ORECF);
+
+    dma_channel_start(dma->channel, ccr, &handle->Instance->RDR, rx, rx_length);
+    handle->Instance->CR3 |= USART_CR3_DMAR | USART_CR3_EIE;
+    handle->Instance->CR1 |= USART_CR1_IDLEIE | USART_CR1_PEIE;
+
+    DEBUG_PRINTF("UART%u: Rx circular: 0=(%u, %u) %x\n", obj->serial.module+1, rx_length, rx_width, HAL_UART_GetState(handle));
+
+    return 0;
+}
+
+size_t serial_rx_circular_index(serial_t *obj)
+{
+    uart_dma_t *dma = &UartRxDma[obj->serial.module];
+
+    if (!dma->active)
+        return 0;
+
+    size_t remaining = dma_channel_remaining(dma->channel);
+    // CNDTR is reloaded with the buffer length when the channel wraps around
+    return (remaining == obj->rx_buff.length) ? 0 : obj->rx_buff.length - remaining;
+}
+
 int serial_irq_handler_asynch(serial_t *obj)
 {
     UART_HandleTypeDef *handle = &UartHandle[obj->serial.module];
 
+    uart_dma_t *rx_dma = &UartRxDma[obj->serial.module];
+
     int status = handle->Instance->ISR;
-    int data = handle->Instance->RDR;
     int event = 0;
+    bool char_match = (status & USART_ISR_CMF) && (handle->Instance->CR1 & USART_CR1_CMIE);
+
+    if (status & USART_ISR_WUF) {
+        // woken up from STOP, the data itself is handled below
+        __HAL_UART_CLEAR_FLAG(handle, USART_ICR_WUCF);
+    }
 
     if (status & USART_ISR_PE) {
         event |= SERIAL_EVENT_RX_PARITY_ERROR;
@@ -572,9 +1612,77 @@ int serial_irq_handler_asynch(serial_t *obj)
         event |= SERIAL_EVENT_RX_OVERRUN_ERROR;
     }
 
-    if ((status & USART_ISR_TC) && (handle->State & 0x10) && !handle->TxXferCount) {
+    if (rx_dma->active) {
+        // no RDR read to clear the error flags with DMA reception
+        if (status & (USART_ISR_PE | USART_ISR_NE | USART_ISR_FE | USART_ISR_ORE)) {
+            __HAL_UART_CLEAR_FLAG(handle, USART_ICR_PECF | USART_ICR_FECF | USART_ICR_NCF | USART_ICR_ORECF);
+        }
+    }
+
+    if (rx_dma->active && rx_dma->circular) {
+        uint32_t flags = dma_channel_flags(rx_dma->channel);
+        if (flags & DMA_CHANNEL_FLAG_HT) {
+            event |= SERIAL_EVENT_RX_HALF_FULL;
+        }
+        if (flags & DMA_CHANNEL_FLAG_TC) {
+            event |= SERIAL_EVENT_RX_FULL;
+        }
+        dma_channel_clear(rx_dma->channel, flags);
+
+        if ((status & USART_ISR_IDLE) && (handle->Instance->CR1 & USART_CR1_IDLEIE)) {
+            __HAL_UART_CLEAR_FLAG(handle, USART_ICR_IDLECF);
+            event |= SERIAL_EVENT_RX_IDLE;
+        }
+
+        obj->rx_buff.pos = serial_rx_circular_index(obj);
+    }
+
+    if (rx_dma->active && !rx_dma->circular) {
+        if (char_match) {
+            // let the channel fetch the matching character from RDR first
+            while ((handle->Instance->ISR & USART_ISR_RXNE) && dma_channel_remaining(rx_dma->channel));
+        }
+        obj->rx_buff.pos = obj->rx_buff.length - dma_channel_remaining(rx_dma->channel);
+
+        if (dma_channel_flags(rx_dma->channel) & DMA_CHANNEL_FLAG_TC) {
+            // last item received
+            uart_rx_finish(obj);
+            // set event rx complete
+            event |= SERIAL_EVENT_RX_COMPLETE;
+        }
+    }
+
+    if (UartTxDma[obj->serial.module].active) {
+        int tx_channel = UartTxDma[obj->serial.module].channel;
+        if (UartTxVector[obj->serial.module].active && (dma_channel_flags(tx_channel) & DMA_CHANNEL_FLAG_TC)) {
+            // last item of the segment in TDR, chain the next one
+            dma_channel_clear(tx_channel, DMA_CHANNEL_FLAG_GI | DMA_CHANNEL_FLAG_TC);
+            uart_tx_vector_next(obj);
+        }
+        // the DMA channel feeds TDR, just keep track of its progress
+        handle->TxXferCount = dma_channel_remaining(tx_channel);
+        obj->tx_buff.pos = UartTxVector[obj->serial.module].sent + handle->TxXferSize - handle->TxXferCount;
+        if ((status & USART_ISR_TC) && handle->TxXferCount) {
+            // the channel stalled for more than a character time, wait for the real end
+            __HAL_UART_CLEAR_FLAG(handle, UART_CLEAR_TCF);
+            status &= ~USART_ISR_TC;
+        }
+    }
+
+    if ((status & USART_ISR_TC) && (handle->State & 0x10) && !handle->TxXferCount && uart_tx_vector_next(obj)) {
+        // a list was queued once the previous one had gone out
+        __HAL_UART_CLEAR_FLAG(handle, UART_CLEAR_TCF);
+        if (!UartTxDma[obj->serial.module].active) {
+            handle->Instance->CR1 &= ~USART_CR1_TCIE;
+            handle->Instance->CR1 |= USART_CR1_TXEIE;
+        }
+    }
+    else if ((status & USART_ISR_TC) && (handle->State & 0x10) && !handle->TxXferCount) {
         // transmission is finally complete
         handle->Instance->CR1 &= ~USART_CR1_TCIE;
+        UartTxVector[obj->serial.module].active = 0;
+        UartTxVector[obj->serial.module].sent = 0;
+        uart_tx_dma_stop(obj);
         // set event tx complete
         event |= SERIAL_EVENT_TX_COMPLETE;
         // update handle state
@@ -584,60 +1692,58 @@ int serial_irq_handler_asynch(serial_t *obj)
             handle->State = HAL_UART_STATE_READY;
         }
     }
-    else if ((status & USART_ISR_TXE) && handle->TxXferCount) {
-        // chose either the tx reg empty or if last byte wait directly for tx complete
-        if (--handle->TxXferCount == 0) {
-            handle->Instance->CR1 &= ~USART_CR1_TXEIE;
-            handle->Instance->CR1 |= USART_CR1_TCIE;
-        }
+    else if ((status & USART_ISR_TXE) && handle->TxXferCount && !UartTxDma[obj->serial.module].active) {
         // copy new data into transmit register
         handle->Instance->TDR = (uint8_t)*handle->pTxBuffPtr++;
         obj->tx_buff.pos++;
+        // chose either the next segment or if last byte wait directly for tx complete
+        if ((--handle->TxXferCount == 0) && !uart_tx_vector_next(obj)) {
+            handle->Instance->CR1 &= ~USART_CR1_TXEIE;
+            handle->Instance->CR1 |= USART_CR1_TCIE;
+        }
     }
 
-    if ((status & USART_ISR_RXNE) && handle->RxXferCount) {
+    if ((status & USART_ISR_RXNE) && handle->RxXferCount && !rx_dma->active) {
+        int data = handle->Instance->RDR;
         // something arrived in the receive buffer
         // copy into buffer
         *handle->pRxBuffPtr++ = (uint8_t)data;
         obj->rx_buff.pos++;
-        // check for character match only if enabled though!
-        if ((obj->serial.char_match != SERIAL_RESERVED_CHAR_MATCH) && ((uint8_t)data == obj->serial.char_match)) {
-            event |= SERIAL_EVENT_RX_CHARACTER_MATCH;
-        }
         if (--handle->RxXferCount == 0) {
-            // last receive byte, disable all rx interrupts
-            handle->Instance->CR1 &= ~(USART_CR1_RXNEIE | USART_CR1_PEIE);
-            handle->Instance->CR3 &= ~USART_CR3_EIE;
+            // last receive byte
+            uart_rx_finish(obj);
             // set event rx complete
             event |= SERIAL_EVENT_RX_COMPLETE;
-            // update handle state
-            if(handle->State == HAL_UART_STATE_BUSY_TX_RX) {
-                handle->State = HAL_UART_STATE_BUSY_TX;
-            } else {
-                handle->State = HAL_UART_STATE_READY;
-            }
         }
     }
 
-    return (event & obj->serial.event);
+    if ((status & USART_ISR_RTOF) && (handle->Instance->CR1 & USART_CR1_RTOIE)) {
+        __HAL_UART_CLEAR_FLAG(handle, USART_ICR_RTOCF);
+        if (rx_dma->active) {
+            // let the channel fetch the last character from RDR first
+            while ((handle->Instance->ISR & USART_ISR_RXNE) && dma_channel_remaining(rx_dma->channel));
+            obj->rx_buff.pos = obj->rx_buff.length - dma_channel_remaining(rx_dma->channel);
+        }
+        // the frame is over, whatever its length
+        uart_rx_finish(obj);
+        event |= SERIAL_EVENT_RX_COMPLETE | SERIAL_EVENT_RX_TIMEOUT;
+    }
+
+    if (char_match) {
+        __HAL_UART_CLEAR_FLAG(handle, USART_ICR_CMCF);
+        event |= SERIAL_EVENT_RX_CHARACTER_MATCH;
+    }
+
+    return (event & (obj->serial.event | rx_dma->event));
 }
 
 void serial_rx_abort_asynch(serial_t *obj)
 {
     UART_HandleTypeDef *handle = &UartHandle[obj->serial.module];
-    // stop interrupts
-    handle->Instance->CR1 &= ~(USART_CR1_RXNEIE | USART_CR1_PEIE);
-    handle->Instance->CR3 &= ~USART_CR3_EIE;
+    // stop interrupts, DMA and reset states
+    uart_rx_finish(obj);
     // clear flags
     __HAL_UART_CLEAR_PEFLAG(handle);
-    // reset states
-    handle->RxXferCount = 0;
-    // update handle state
-    if(handle->State == HAL_UART_STATE_BUSY_TX_RX) {
-        handle->State = HAL_UART_STATE_BUSY_TX;
-    } else {
-        handle->State = HAL_UART_STATE_READY;
-    }
 }
 
 void serial_tx_abort_asynch(serial_t *obj)
@@ -645,10 +1751,15 @@ void serial_tx_abort_asynch(serial_t *obj)
     UART_HandleTypeDef *handle = &UartHandle[obj->serial.module];
     // stop interrupts
     handle->Instance->CR1 &= ~(USART_CR1_TCIE | USART_CR1_TXEIE);
+    // stop the DMA channel, if any
+    uart_tx_dma_stop(obj);
     // clear flags
     __HAL_UART_CLEAR_PEFLAG(handle);
     // reset states
     handle->TxXferCount = 0;
+    UartTxVector[obj->serial.module].active = 0;
+    UartTxVector[obj->serial.module].sent = 0;
+    UartTxVector[obj->serial.module].tail = UartTxVector[obj->serial.module].head;
     // update handle state
     if(handle->State == HAL_UART_STATE_BUSY_TX_RX) {
         handle->State = HAL_UART_STATE_BUSY_RX;
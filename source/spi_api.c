@@ -41,6 +41,11 @@
 #include "mbed-drivers/mbed_error.h"
 #include "PeripheralPins.h"
 #include "target_config.h"
+#include "dma_channel.h"
+#include "spi_ext_api.h"
+#if DEVICE_SPISLAVE
+#include "gpio_irq_api.h"
+#endif
 
 #define DEBUG_STDIO 0
 
@@ -49,19 +54,12 @@
 #endif
 
 #if DEBUG_STDIO
-#   include <stdio.h>
-#   define DEBUG_PRINTF(...) do { printf(__VA_ARGS__); } while(0)
+#   include "debug_log.h"
+#   define DEBUG_PRINTF(...) do { debug_log_printf(__VA_ARGS__); } while(0)
 #else
 #   define DEBUG_PRINTF(...) {}
 #endif
 
-typedef enum {
-    SPI_TRANSFER_TYPE_NONE = 0,
-    SPI_TRANSFER_TYPE_TX = 1,
-    SPI_TRANSFER_TYPE_RX = 2,
-    SPI_TRANSFER_TYPE_TXRX = 3,
-} transfer_type_t;
-
 
 static SPI_HandleTypeDef SpiHandle[MODULE_SIZE_SPI];
 static const IRQn_Type SpiIRQs[MODULE_SIZE_SPI] = {
@@ -80,19 +78,649 @@ static const IRQn_Type SpiIRQs[MODULE_SIZE_SPI] = {
 };
 
 
-static void init_spi(spi_t *obj)
+// DMA transfers: the RX channel always runs, so that its completion ends the
+// transfer and no received frame is left to overrun the FIFO
+typedef struct spi_dma {
+    int tx_channel;             // claimed DMA channels, DMA_CHANNEL_NONE if none
+    int rx_channel;
+    uint8_t keep;               // keep the channels between transfers (DMA_USAGE_ALWAYS)
+    uint8_t active;             // a transfer is running on the channels
+    uint8_t tx_used;            // the current chunk reads tx_buff / writes rx_buff
+    uint8_t rx_used;
+    size_t bytes;               // size of the current chunk
+} spi_dma_t;
+
+static spi_dma_t SpiDma[MODULE_SIZE_SPI];
+
+static const DMARequestName SpiTxDmaRequests[MODULE_SIZE_SPI] = {
+    DMA_REQ_SPI1_TX,
+    DMA_REQ_SPI2_TX,
+    DMA_REQ_SPI3_TX,
+};
+
+static const DMARequestName SpiRxDmaRequests[MODULE_SIZE_SPI] = {
+    DMA_REQ_SPI1_RX,
+    DMA_REQ_SPI2_RX,
+    DMA_REQ_SPI3_RX,
+};
+
+// Interrupt driven transfers: a single pass over max(tx, rx) frames, the TX FIFO is
+// kept full while the frames in flight still fit into the RX FIFO
+typedef struct spi_stream {
+    size_t total;               // frames clocked by the transfer
+    size_t sent;
+    size_t received;
+    size_t crc;                 // CRC frames received after the data frames
+    uint8_t active;
+} spi_stream_t;
+
+static spi_stream_t SpiStream[MODULE_SIZE_SPI];
+
+// Transaction queue, run back to back from the SPI and DMA interrupts
+typedef struct spi_queue {
+    spi_t *obj;                     // bus object the transactions run on
+    spi_transaction_t *head;        // running transaction, NULL when idle
+    spi_transaction_t *tail;
+    DMAUsage hint;
+    uint8_t hardware_cs;            // NSS output (SSOE): SPE is only set during transactions
+} spi_queue_t;
+
+static spi_queue_t SpiQueue[MODULE_SIZE_SPI];
+
+#if DEVICE_SPISLAVE
+// Slave transfers, run on the DMA channels between two rising edges of NSS
+typedef struct spi_slave {
+    gpio_irq_t nss;             // EXTI line of the NSS pin, left on its alternate function
+    uint32_t handler;           // asynch handler, called on the rising edge of NSS too
+    size_t frames;              // frames clocked by the master in the finished RX chunks
+    uint16_t rx_count;          // frames of the running RX chunk
+    uint8_t tx_fill;            // the TX buffer is out, the TX channel clocks the fill word
+    uint8_t rx_sink;            // the RX buffer is full, the RX channel writes into the sink
+    uint8_t ended;              // NSS went high
+    uint8_t enabled;
+    uint8_t active;
+} spi_slave_t;
+
+static spi_slave_t SpiSlave[MODULE_SIZE_SPI];
+#endif
+
+// clocked out instead of missing TX data, written into instead of missing RX buffers
+static const uint16_t spi_fill_word = SPI_FILL_WORD;
+static uint16_t spi_sink_word;
+
+static void spi_dma_release(spi_dma_t *dma)
 {
-    SPI_HandleTypeDef *handle = &SpiHandle[obj->spi.module];
+    if (dma->tx_channel != DMA_CHANNEL_NONE) {
+        dma_channel_stop(dma->tx_channel);
+    }
+    if (dma->rx_channel != DMA_CHANNEL_NONE) {
+        dma_channel_stop(dma->rx_channel);
+    }
+    if (!dma->keep) {
+        dma_channel_release(dma->tx_channel);
+        dma_channel_release(dma->rx_channel);
+        dma->tx_channel = DMA_CHANNEL_NONE;
+        dma->rx_channel = DMA_CHANNEL_NONE;
+    }
+}
 
-    __HAL_SPI_DISABLE(handle);
+/******************************************************************************
+ * USART SYNCHRONOUS MODE
+ ******************************************************************************/
 
-    HAL_SPI_Init(handle);
+// USART1 to USART3 drive the bus in synchronous master mode (CK as SCLK, TX as
+// MOSI, RX as MISO), their module numbers follow the SPI instances
+#define SPI_USART_NUM (3)
 
-    __HAL_SPI_ENABLE(handle);
+typedef struct spi_usart {
+    USART_TypeDef *instance;
+    spi_dma_t dma;              // whole transfers, no chunks
+    uint8_t active;
+    size_t total;               // frames clocked by the transfer
+    size_t done;
+} spi_usart_t;
+
+static spi_usart_t SpiUsart[SPI_USART_NUM];
+
+static const IRQn_Type SpiUsartIRQs[SPI_USART_NUM] = {
+    USART1_IRQn,
+    USART2_IRQn,
+    USART3_IRQn,
+};
+
+static const DMARequestName SpiUsartTxDmaRequests[SPI_USART_NUM] = {
+    DMA_REQ_USART1_TX,
+    DMA_REQ_USART2_TX,
+    DMA_REQ_USART3_TX,
+};
+
+static const DMARequestName SpiUsartRxDmaRequests[SPI_USART_NUM] = {
+    DMA_REQ_USART1_RX,
+    DMA_REQ_USART2_RX,
+    DMA_REQ_USART3_RX,
+};
+
+// The pin modules of the targets without synchronous USART pins don't define
+// this map: the SPI instances are the only masters then
+__attribute__((weak)) const PinMap PinMap_USART_CK[] = {
+    {NC, (int)NC, 0}
+};
+
+// clocked out instead of missing TX data, written into by the RX only transfers
+static const uint8_t spi_usart_fill = (uint8_t)SPI_FILL_WORD;
+static uint8_t spi_usart_sink;
+
+static inline spi_usart_t *spi_usart(spi_t *obj)
+{
+    if (obj->spi.module < MODULE_SIZE_SPI)
+        return NULL;
+    return &SpiUsart[obj->spi.module - MODULE_SIZE_SPI];
+}
+
+static uint32_t spi_usart_clock(uint8_t id)
+{
+    // kernel clock selected in RCC_CCIPR, 2 bits per USART
+    switch ((RCC->CCIPR >> (2 * id)) & 0x3) {
+        case 1:
+            return HAL_RCC_GetSysClockFreq();
+        case 2:
+            return HSI_VALUE;
+        case 3:
+            return LSE_VALUE;
+        default:
+            return (id == 0) ? HAL_RCC_GetPCLK2Freq() : HAL_RCC_GetPCLK1Freq();
+    }
+}
+
+static void spi_usart_frequency(spi_t *obj, int hz)
+{
+    uint8_t id = obj->spi.module - MODULE_SIZE_SPI;
+    USART_TypeDef *uart = SpiUsart[id].instance;
+
+    if (hz <= 0) {
+        error("USART%u: %d Hz SPI clock not supported\n", id+1, hz);
+    }
+
+    // 8x oversampling: SCLK = 2 * fck / USARTDIV, at most fck / 8, never above hz
+    uint32_t clock = spi_usart_clock(id);
+    uint32_t div = ((2 * clock) + (uint32_t)hz - 1) / (uint32_t)hz;
+    // BRR has no room for bit 0 of USARTDIV: round up to an even divider
+    div = (div + 1) & ~1U;
+    if (div < 16) {
+        div = 16;
+    } else if (div > 0xFFFE) {
+        div = 0xFFFE;
+    }
+
+    uart->CR1 &= ~USART_CR1_UE;
+    uart->BRR = (div & 0xFFF0) | ((div & 0x000F) >> 1);
+    uart->CR1 |= USART_CR1_UE;
+
+    DEBUG_PRINTF("USART%u: Frequency: %u, %u\n", id+1, hz, spi_frequency_actual(obj));
+}
+
+static void spi_usart_format(spi_t *obj, int bits, int mode, spi_bitorder_t order)
+{
+    uint8_t id = obj->spi.module - MODULE_SIZE_SPI;
+    USART_TypeDef *uart = SpiUsart[id].instance;
+
+    if (bits != 8) {
+        error("USART%u: %d bit SPI frames not supported\n", id+1, bits);
+    }
+
+    // LBCL: the clock pulse of the last data bit is output too
+    uint32_t cr2 = USART_CR2_CLKEN | USART_CR2_LBCL;
+    if (mode & 2) {
+        cr2 |= USART_CR2_CPOL;
+    }
+    if (mode & 1) {
+        cr2 |= USART_CR2_CPHA;
+    }
+    if (order == SPI_MSB) {
+        cr2 |= USART_CR2_MSBFIRST;
+    }
+
+    // the clock configuration can only be written while the USART is disabled
+    uart->CR1 &= ~USART_CR1_UE;
+    uart->CR2 = (uart->CR2 & ~(USART_CR2_CLKEN | USART_CR2_LBCL | USART_CR2_CPOL | USART_CR2_CPHA | USART_CR2_MSBFIRST)) | cr2;
+    uart->CR1 |= USART_CR1_UE;
+
+    DEBUG_PRINTF("USART%u: Format: %u, %u, %u\n", id+1, bits, mode, order);
+}
+
+static void spi_usart_init(spi_t *obj, UARTName instance, PinName mosi, PinName miso, PinName sclk)
+{
+    uint8_t id;
+
+    switch (instance) {
+        case UART_1:
+            __USART1_CLK_ENABLE();
+            id = 0;
+            break;
+        case UART_2:
+            __USART2_CLK_ENABLE();
+            id = 1;
+            break;
+        case UART_3:
+            __USART3_CLK_ENABLE();
+            id = 2;
+            break;
+        default:
+            error("Synchronous mode not supported on this USART\n");
+            return;
+    }
+    obj->spi.module = MODULE_SIZE_SPI + id;
+
+    // Configure the USART pins
+    pinmap_pinout(mosi, PinMap_UART_TX);
+    pinmap_pinout(miso, PinMap_UART_RX);
+    pinmap_pinout(sclk, PinMap_USART_CK);
+
+    obj->spi.pin_miso = miso;
+    obj->spi.pin_mosi = mosi;
+    obj->spi.pin_sclk = sclk;
+
+    spi_usart_t *usart = &SpiUsart[id];
+    memset(usart, 0, sizeof(spi_usart_t));
+    usart->instance = (USART_TypeDef *)instance;
+
+    // 8 data bits, no parity, both directions: every frame sent clocks one in
+    usart->instance->CR1 = 0;
+    usart->instance->CR3 = 0;
+    usart->instance->CR1 = USART_CR1_OVER8 | USART_CR1_TE | USART_CR1_RE;
+
+    DEBUG_PRINTF("USART%u: SPI Init\n", id+1);
+
+    spi_usart_format(obj, 8, 0, SPI_MSB);
+    spi_usart_frequency(obj, 1000000);
+}
+
+static void spi_usart_free(spi_t *obj)
+{
+    uint8_t id = obj->spi.module - MODULE_SIZE_SPI;
+    spi_usart_t *usart = &SpiUsart[id];
+
+    switch (id) {
+        case 0:
+            __USART1_FORCE_RESET();
+            __USART1_RELEASE_RESET();
+            __USART1_CLK_DISABLE();
+            break;
+        case 1:
+            __USART2_FORCE_RESET();
+            __USART2_RELEASE_RESET();
+            __USART2_CLK_DISABLE();
+            break;
+        case 2:
+            __USART3_FORCE_RESET();
+            __USART3_RELEASE_RESET();
+            __USART3_CLK_DISABLE();
+            break;
+    }
+
+    // Give back the DMA channels
+    usart->dma.keep = 0;
+    spi_dma_release(&usart->dma);
+
+    DEBUG_PRINTF("USART%u: SPI Free\n", id+1);
+}
+
+static int spi_usart_master_write(spi_t *obj, int value)
+{
+    USART_TypeDef *uart = spi_usart(obj)->instance;
+
+    while (!(uart->ISR & USART_ISR_TXE));
+    uart->TDR = (uint8_t)value;
+    while (!(uart->ISR & USART_ISR_RXNE));
+    return (int)(uint8_t)uart->RDR;
+}
+
+static void spi_usart_finish(spi_t *obj)
+{
+    spi_usart_t *usart = spi_usart(obj);
+    USART_TypeDef *uart = usart->instance;
+
+    uart->CR1 &= ~USART_CR1_RXNEIE;
+    uart->CR3 &= ~(USART_CR3_DMAT | USART_CR3_DMAR | USART_CR3_EIE);
+    if (usart->dma.active) {
+        spi_dma_release(&usart->dma);
+        usart->dma.active = 0;
+    }
+    usart->active = 0;
+}
+
+// Both directions are streamed by two DMA channels, the RX channel reports the end
+static int spi_usart_dma_start(spi_t *obj, uint32_t handler, DMAUsage hint)
+{
+    spi_usart_t *usart = spi_usart(obj);
+    uint8_t id = obj->spi.module - MODULE_SIZE_SPI;
+    USART_TypeDef *uart = usart->instance;
+    bool use_tx = (obj->tx_buff.length > 0);
+    bool use_rx = (obj->rx_buff.length > 0);
+
+    // the channels cannot switch to the fill word/sink halfway through
+    if (hint == DMA_USAGE_NEVER || usart->total > 0xFFFF)
+        return 0;
+    if (use_tx && use_rx && (obj->tx_buff.length != obj->rx_buff.length))
+        return 0;
+
+    spi_dma_t *dma = &usart->dma;
+    if (dma->tx_channel == DMA_CHANNEL_NONE) {
+        dma->tx_channel = dma_channel_claim(SpiUsartTxDmaRequests[id]);
+    }
+    if (dma->rx_channel == DMA_CHANNEL_NONE) {
+        dma->rx_channel = dma_channel_claim(SpiUsartRxDmaRequests[id]);
+    }
+    if ((dma->tx_channel == DMA_CHANNEL_NONE) || (dma->rx_channel == DMA_CHANNEL_NONE)) {
+        // no free channel, the caller falls back to the interrupt path
+        dma->keep = 0;
+        spi_dma_release(dma);
+        return 0;
+    }
+    dma->keep = (hint == DMA_USAGE_ALWAYS);
+    dma->active = 1;
+
+    IRQn_Type dma_irq_n = dma_channel_irq(dma->rx_channel);
+    vIRQ_SetVector(dma_irq_n, handler);
+    vIRQ_EnableIRQ(dma_irq_n);
+
+    // RX first and at a higher priority, it must never fall behind TX
+    dma_channel_start(dma->rx_channel, DMA_CCR_TCIE | DMA_CCR_PL_0 | (use_rx ? DMA_CCR_MINC : 0),
+                      &uart->RDR, use_rx ? obj->rx_buff.buffer : &spi_usart_sink, usart->total);
+    uart->CR3 |= USART_CR3_DMAR | USART_CR3_DMAT | USART_CR3_EIE;
+    dma_channel_start(dma->tx_channel, DMA_CCR_DIR | (use_tx ? DMA_CCR_MINC : 0),
+                      &uart->TDR, use_tx ? obj->tx_buff.buffer : &spi_usart_fill, usart->total);
+
+    return 1;
+}
+
+static void spi_usart_write_next(spi_t *obj)
+{
+    USART_TypeDef *uart = spi_usart(obj)->instance;
+
+    if (obj->tx_buff.pos < obj->tx_buff.length) {
+        uart->TDR = ((uint8_t *)obj->tx_buff.buffer)[obj->tx_buff.pos++];
+    } else {
+        uart->TDR = spi_usart_fill;
+    }
+}
+
+static void spi_usart_master_transfer(spi_t *obj, uint32_t handler, DMAUsage hint)
+{
+    spi_usart_t *usart = spi_usart(obj);
+    uint8_t id = obj->spi.module - MODULE_SIZE_SPI;
+    USART_TypeDef *uart = usart->instance;
+
+    usart->total = (obj->tx_buff.length > obj->rx_buff.length) ? obj->tx_buff.length : obj->rx_buff.length;
+    usart->done = 0;
+    usart->active = 1;
+
+    // register the thunking handler
+    vIRQ_SetVector(SpiUsartIRQs[id], handler);
+    vIRQ_EnableIRQ(SpiUsartIRQs[id]);
+
+    // drop whatever was left from a previous transfer
+    uart->RQR = USART_RQR_RXFRQ;
+    uart->ICR = USART_ICR_ORECF | USART_ICR_FECF | USART_ICR_NCF;
+
+    if (spi_usart_dma_start(obj, handler, hint)) {
+        DEBUG_PRINTF("USART%u: Transfer DMA: %u, %u\n", id+1, obj->tx_buff.length, obj->rx_buff.length);
+        return;
+    }
+
+    // one frame in flight, the next one is written when its reply is read
+    uart->CR1 |= USART_CR1_RXNEIE;
+    spi_usart_write_next(obj);
+
+    DEBUG_PRINTF("USART%u: Transfer: %u, %u\n", id+1, obj->tx_buff.length, obj->rx_buff.length);
+}
+
+static uint32_t spi_usart_irq_handler_asynch(spi_t *obj)
+{
+    spi_usart_t *usart = spi_usart(obj);
+    USART_TypeDef *uart = usart->instance;
+    uint32_t status = uart->ISR;
+    int event = 0;
+
+    if (status & USART_ISR_ORE) {
+        uart->ICR = USART_ICR_ORECF;
+        spi_usart_finish(obj);
+        event = SPI_EVENT_ERROR | SPI_EVENT_RX_OVERFLOW | SPI_EVENT_INTERNAL_TRANSFER_COMPLETE;
+    } else if (usart->dma.active) {
+        if (dma_channel_flags(usart->dma.rx_channel) & DMA_CHANNEL_FLAG_TC) {
+            // the last frame is in: both directions are over
+            obj->tx_buff.pos = obj->tx_buff.length;
+            obj->rx_buff.pos = obj->rx_buff.length;
+            spi_usart_finish(obj);
+            event = SPI_EVENT_COMPLETE | SPI_EVENT_INTERNAL_TRANSFER_COMPLETE;
+        }
+    } else if (status & USART_ISR_RXNE) {
+        uint8_t data = (uint8_t)uart->RDR;
+        if (obj->rx_buff.pos < obj->rx_buff.length) {
+            ((uint8_t *)obj->rx_buff.buffer)[obj->rx_buff.pos++] = data;
+        }
+        if (++usart->done < usart->total) {
+            spi_usart_write_next(obj);
+        } else {
+            spi_usart_finish(obj);
+            event = SPI_EVENT_COMPLETE | SPI_EVENT_INTERNAL_TRANSFER_COMPLETE;
+        }
+    }
+
+    return (event & (obj->spi.event | SPI_EVENT_INTERNAL_TRANSFER_COMPLETE));
+}
+
+static void spi_usart_abort_asynch(spi_t *obj)
+{
+    USART_TypeDef *uart = spi_usart(obj)->instance;
+
+    spi_usart_finish(obj);
+    // let the frame in flight complete, then drop its reply
+    while (!(uart->ISR & USART_ISR_TC));
+    uart->RQR = USART_RQR_RXFRQ;
+    uart->ICR = USART_ICR_ORECF;
+}
+
+/******************************************************************************
+ * SPI
+ ******************************************************************************/
+
+// SCK = bus clock / 2, 4, ..., 256
+static const uint32_t SpiPrescalers[8] = {
+    SPI_BAUDRATEPRESCALER_2,
+    SPI_BAUDRATEPRESCALER_4,
+    SPI_BAUDRATEPRESCALER_8,
+    SPI_BAUDRATEPRESCALER_16,
+    SPI_BAUDRATEPRESCALER_32,
+    SPI_BAUDRATEPRESCALER_64,
+    SPI_BAUDRATEPRESCALER_128,
+    SPI_BAUDRATEPRESCALER_256,
+};
+
+// Frames of 9 to 16 bits take a half-word in the buffers and in the FIFO accesses,
+// frames of 4 to 8 bits a byte
+static inline bool spi_wide_frames(SPI_HandleTypeDef *handle)
+{
+    return (handle->Init.DataSize > SPI_DATASIZE_8BIT);
+}
+
+static uint32_t spi_clock(uint8_t module)
+{
+    // SPI1 is on APB2, SPI2 and SPI3 on APB1
+    return (module == 0) ? HAL_RCC_GetPCLK2Freq() : HAL_RCC_GetPCLK1Freq();
+}
+
+// CR2 bits set by the configuration, the others are the interrupt and DMA enables
+#define SPI_CR2_CONFIG (SPI_CR2_DS | SPI_CR2_FRXTH | SPI_CR2_SSOE | SPI_CR2_NSSP | SPI_CR2_FRF)
+
+// The CRC unit runs on 8 or 16 bit frames, 8 bit CRCs on 8 bit frames only
+static inline bool spi_crc_supported(const SPI_InitTypeDef *init)
+{
+    return (init->DataSize == SPI_DATASIZE_8BIT) ||
+           ((init->DataSize == SPI_DATASIZE_16BIT) && (init->CRCLength != SPI_CRC_LENGTH_8BIT));
+}
+
+// CR1 and CR2 as HAL_SPI_Init() programs them for these settings
+static void spi_config_image(const SPI_InitTypeDef *init, uint32_t *cr1, uint32_t *cr2)
+{
+    *cr1 = init->Mode | init->Direction | init->CLKPolarity | init->CLKPhase | (init->NSS & SPI_CR1_SSM) |
+           init->BaudRatePrescaler | init->FirstBit;
+
+    if ((init->CRCCalculation == SPI_CRCCALCULATION_ENABLED) && spi_crc_supported(init)) {
+        *cr1 |= SPI_CR1_CRCEN;
+        if ((init->CRCLength == SPI_CRC_LENGTH_16BIT) || (init->DataSize == SPI_DATASIZE_16BIT)) {
+            *cr1 |= SPI_CR1_CRCL;
+        }
+    }
+
+    *cr2 = ((init->NSS >> 16) & SPI_CR2_SSOE) | init->TIMode | init->NSSPMode | init->DataSize;
+    // RXNE on every byte up to 8 bit frames, on every half-word above
+    if (init->DataSize <= SPI_DATASIZE_8BIT) {
+        *cr2 |= SPI_CR2_FRXTH;
+    }
+}
+
+// Reprogram the bus only if the registers do not hold these settings already
+static void spi_config_write(uint8_t module, uint32_t cr1, uint32_t cr2)
+{
+    SPI_TypeDef *spi = SpiHandle[module].Instance;
+
+    if (((spi->CR1 & ~SPI_CR1_SPE) != cr1) || ((spi->CR2 & SPI_CR2_CONFIG) != cr2)) {
+        // the configuration bits can only change with the SPI off
+        spi->CR1 &= ~SPI_CR1_SPE;
+        spi->CR1 = cr1;
+        spi->CR2 = (spi->CR2 & ~SPI_CR2_CONFIG) | cr2;
+    }
+
+    // with the NSS output, SPE asserts the chip select: set around each transfer only
+    if (!SpiQueue[module].hardware_cs) {
+        spi->CR1 |= SPI_CR1_SPE;
+    }
+}
+
+// CRC frames the SPI appends to each transfer, 0 without CRC
+static inline size_t spi_crc_frames(SPI_HandleTypeDef *handle)
+{
+    uint32_t cr1 = handle->Instance->CR1;
+
+    if (!(cr1 & SPI_CR1_CRCEN))
+        return 0;
+    // a 16 bit CRC takes two 8 bit frames
+    return ((cr1 & SPI_CR1_CRCL) && !spi_wide_frames(handle)) ? 2 : 1;
+}
+
+// Clear TXCRCR and RXCRCR for the next transfer
+static void spi_crc_reset(uint8_t module)
+{
+    SPI_TypeDef *spi = SpiHandle[module].Instance;
+    uint32_t cr1 = spi->CR1 & ~SPI_CR1_CRCNEXT;
+
+    if (!(cr1 & SPI_CR1_CRCEN))
+        return;
+
+    // CRCEN only changes with the SPI off, once the last frame is out
+    while (spi->SR & SPI_SR_BSY);
+    spi->CR1 = cr1 & ~(SPI_CR1_SPE | SPI_CR1_CRCEN);
+    spi->CR1 = cr1 & ~SPI_CR1_SPE;
+    // with the NSS output, SPE asserts the chip select: set around each transfer only
+    if (!SpiQueue[module].hardware_cs) {
+        spi->CR1 = cr1;
+    }
+}
+
+/// Read the CRC frames still in the RX FIFO, then check and reset the CRC unit
+/// @returns 1 if the received CRC did not match
+static int spi_crc_end(uint8_t module, size_t frames)
+{
+    SPI_HandleTypeDef *handle = &SpiHandle[module];
+    SPI_TypeDef *spi = handle->Instance;
+    int mismatch;
+
+    while (frames--) {
+        while (!(spi->SR & SPI_SR_RXNE));
+        if (spi_wide_frames(handle)) {
+            (void)spi->DR;
+        } else {
+            (void)*(volatile uint8_t *)&spi->DR;
+        }
+    }
+
+    mismatch = ((spi->SR & SPI_SR_CRCERR) != 0);
+    // CRCERR is cleared by writing 0
+    spi->SR = (uint16_t)~SPI_SR_CRCERR;
+    spi_crc_reset(module);
+
+    return mismatch;
+}
+
+// With the NSS output, SPE asserts the chip select for the time of a transfer
+static void spi_hardware_cs_begin(uint8_t module)
+{
+    if (SpiQueue[module].hardware_cs) {
+        __HAL_SPI_ENABLE(&SpiHandle[module]);
+    }
+}
+
+static void spi_hardware_cs_end(uint8_t module)
+{
+    SPI_HandleTypeDef *handle = &SpiHandle[module];
+
+    if (SpiQueue[module].hardware_cs) {
+        // the last frame is in, wait for the clock to settle before releasing the device
+        while (__HAL_SPI_GET_FLAG(handle, SPI_FLAG_BSY) != RESET);
+        __HAL_SPI_DISABLE(handle);
+    }
+}
+
+// Only an SPI reset through RCC empties the TX FIFO of frames nobody clocks out
+// (a slave the master left, a master with SPE off): the registers are rewritten
+// from the handle afterwards, SPE stays off
+static void spi_reset(uint8_t module)
+{
+    SPI_HandleTypeDef *handle = &SpiHandle[module];
+    uint32_t cr1, cr2;
+
+    switch (module) {
+        case 0:
+            __SPI1_FORCE_RESET();
+            __SPI1_RELEASE_RESET();
+            break;
+        case 1:
+            __SPI2_FORCE_RESET();
+            __SPI2_RELEASE_RESET();
+            break;
+        case 2:
+            __SPI3_FORCE_RESET();
+            __SPI3_RELEASE_RESET();
+            break;
+        default:
+            break;
+    }
+
+    spi_config_image(&handle->Init, &cr1, &cr2);
+    handle->Instance->CRCPR = handle->Init.CRCPolynomial;
+    handle->Instance->CR1 = cr1;
+    handle->Instance->CR2 = cr2;
+}
+
+static void init_spi(spi_t *obj)
+{
+    uint32_t cr1, cr2;
+
+    spi_config_image(&SpiHandle[obj->spi.module].Init, &cr1, &cr2);
+    spi_config_write(obj->spi.module, cr1, cr2);
 }
 
 void spi_init(spi_t *obj, PinName mosi, PinName miso, PinName sclk)
 {
+    // A USART CK pin as SCLK selects the USART in synchronous mode
+    UARTName usart = (UARTName)pinmap_find_peripheral(sclk, PinMap_USART_CK);
+    if (usart != (UARTName)NC) {
+        MBED_ASSERT(pinmap_merge(pinmap_peripheral(mosi, PinMap_UART_TX), pinmap_peripheral(miso, PinMap_UART_RX)) == (uint32_t)usart);
+        spi_usart_init(obj, usart, mosi, miso, sclk);
+        return;
+    }
+
     // Determine the SPI to use
     SPIName spi_mosi = (SPIName)pinmap_peripheral(mosi, PinMap_SPI_MOSI);
     SPIName spi_miso = (SPIName)pinmap_peripheral(miso, PinMap_SPI_MISO);
@@ -147,6 +775,10 @@ void spi_init(spi_t *obj, PinName mosi, PinName miso, PinName sclk)
     obj->spi.pin_miso = miso;
     obj->spi.pin_mosi = mosi;
     obj->spi.pin_sclk = sclk;
+    obj->spi.pin_ssel = NC;
+
+    // no transactions nor chip select left from an earlier user of the SPI
+    memset(&SpiQueue[obj->spi.module], 0, sizeof(SpiQueue[obj->spi.module]));
 
     // initialize the handle for this master!
     SPI_HandleTypeDef *handle = &SpiHandle[obj->spi.module];
@@ -166,11 +798,22 @@ void spi_init(spi_t *obj, PinName mosi, PinName miso, PinName sclk)
 
     DEBUG_PRINTF("SPI%u: Init\n", obj->spi.module+1);
 
+    // the only full init, format and frequency changes rewrite CR1 and CR2 from there
+    HAL_SPI_Init(handle);
     init_spi(obj);
 }
 
 void spi_free(spi_t *obj)
 {
+    if (spi_usart(obj)) {
+        spi_usart_free(obj);
+        // Configure GPIOs
+        pin_function(obj->spi.pin_miso, STM_PIN_DATA(STM_MODE_INPUT, GPIO_NOPULL, 0));
+        pin_function(obj->spi.pin_mosi, STM_PIN_DATA(STM_MODE_INPUT, GPIO_NOPULL, 0));
+        pin_function(obj->spi.pin_sclk, STM_PIN_DATA(STM_MODE_INPUT, GPIO_NOPULL, 0));
+        return;
+    }
+
     // Reset SPI and disable clock
     switch(obj->spi.module) {
         case 0:
@@ -213,105 +856,175 @@ void spi_free(spi_t *obj)
             break;
     }
 
+#if DEVICE_SPISLAVE
+    if (SpiSlave[obj->spi.module].enabled) {
+        gpio_irq_free(&SpiSlave[obj->spi.module].nss);
+        SpiSlave[obj->spi.module].enabled = 0;
+        SpiSlave[obj->spi.module].active = 0;
+    }
+#endif
+
+    // Give back the DMA channels
+    SpiDma[obj->spi.module].keep = 0;
+    spi_dma_release(&SpiDma[obj->spi.module]);
+    SpiDma[obj->spi.module].active = 0;
+
+    // Drop the queued transactions and the hardware chip select
+    memset(&SpiQueue[obj->spi.module], 0, sizeof(SpiQueue[obj->spi.module]));
+
     // Configure GPIOs
     pin_function(obj->spi.pin_miso, STM_PIN_DATA(STM_MODE_INPUT, GPIO_NOPULL, 0));
     pin_function(obj->spi.pin_mosi, STM_PIN_DATA(STM_MODE_INPUT, GPIO_NOPULL, 0));
     pin_function(obj->spi.pin_sclk, STM_PIN_DATA(STM_MODE_INPUT, GPIO_NOPULL, 0));
+    if (obj->spi.pin_ssel != NC) {
+        pin_function(obj->spi.pin_ssel, STM_PIN_DATA(STM_MODE_INPUT, GPIO_NOPULL, 0));
+    }
 
     DEBUG_PRINTF("SPI%u: Free\n", obj->spi.module+1);
 }
 
 
-void spi_format(spi_t *obj, int bits, int mode, spi_bitorder_t order)
+static void spi_format_init(SPI_InitTypeDef *init, uint8_t module, int bits, int mode, spi_bitorder_t order)
 {
-    SPI_HandleTypeDef *handle = &SpiHandle[obj->spi.module];
-
-    // Save new values
-    if (bits == 16) {
-        handle->Init.DataSize = SPI_DATASIZE_16BIT;
-    } else {
-        handle->Init.DataSize = SPI_DATASIZE_8BIT;
+    if ((bits < 4) || (bits > 16)) {
+        error("SPI%u: %d bit frames not supported\n", module+1, bits);
     }
 
+    // DS in CR2[11:8] holds the frame size minus one
+    init->DataSize = (uint32_t)(bits - 1) << 8;
+
     switch (mode) {
         case 0:
-            handle->Init.CLKPolarity = SPI_POLARITY_LOW;
-            handle->Init.CLKPhase = SPI_PHASE_1EDGE;
+            init->CLKPolarity = SPI_POLARITY_LOW;
+            init->CLKPhase = SPI_PHASE_1EDGE;
             break;
         case 1:
-            handle->Init.CLKPolarity = SPI_POLARITY_LOW;
-            handle->Init.CLKPhase = SPI_PHASE_2EDGE;
+            init->CLKPolarity = SPI_POLARITY_LOW;
+            init->CLKPhase = SPI_PHASE_2EDGE;
             break;
         case 2:
-            handle->Init.CLKPolarity = SPI_POLARITY_HIGH;
-            handle->Init.CLKPhase = SPI_PHASE_1EDGE;
+            init->CLKPolarity = SPI_POLARITY_HIGH;
+            init->CLKPhase = SPI_PHASE_1EDGE;
             break;
         default:
-            handle->Init.CLKPolarity = SPI_POLARITY_HIGH;
-            handle->Init.CLKPhase = SPI_PHASE_2EDGE;
+            init->CLKPolarity = SPI_POLARITY_HIGH;
+            init->CLKPhase = SPI_PHASE_2EDGE;
             break;
     }
 
     if (order == SPI_MSB) {
-        handle->Init.FirstBit = SPI_FIRSTBIT_MSB;
+        init->FirstBit = SPI_FIRSTBIT_MSB;
     } else {
-        handle->Init.FirstBit = SPI_FIRSTBIT_LSB;
+        init->FirstBit = SPI_FIRSTBIT_LSB;
     }
+}
 
-    DEBUG_PRINTF("SPI%u: Format: %u, %u, %u\n", obj->spi.module+1, bits, mode, order);
+static void spi_frequency_init(SPI_InitTypeDef *init, uint8_t module, int hz)
+{
+    uint32_t clock = spi_clock(module);
+    int i;
 
-    init_spi(obj);
+    // the fastest SCK = clock / 2^(i+1) not above the request, the slowest one otherwise
+    for (i = 0; i < 7; i++) {
+        if ((clock >> (i + 1)) <= (uint32_t)hz)
+            break;
+    }
+    init->BaudRatePrescaler = SpiPrescalers[i];
 }
 
-void spi_frequency(spi_t *obj, int hz)
+void spi_format(spi_t *obj, int bits, int mode, spi_bitorder_t order)
 {
-       SPI_HandleTypeDef *handle = &SpiHandle[obj->spi.module];
-
-    // Values depend of PCLK1 and PCLK2: 80 MHz if MSI or HSI is used, 48 MHz if HSE is used
-    if (SystemCoreClock == 80000000) { // MSI or HSI
-        if (hz < 600000) {
-            handle->Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_256; // 313 kHz
-        } else if ((hz >= 600000) && (hz < 1000000)) {
-            handle->Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_128; // 625 kHz
-        } else if ((hz >= 1000000) && (hz < 2000000)) {
-            handle->Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_64; // 1.25 MHz (default)
-        } else if ((hz >= 2000000) && (hz < 5000000)) {
-            handle->Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_32; // 2.5 MHz
-        } else if ((hz >= 5000000) && (hz < 10000000)) {
-            handle->Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_16; // 5 MHz
-        } else if ((hz >= 10000000) && (hz < 20000000)) {
-            handle->Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_8; // 10 MHz
-        } else if ((hz >= 20000000) && (hz < 40000000)) {
-            handle->Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_4; // 20 MHz
-        } else { // >= 40000000
-            handle->Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_2; // 40 MHz
-        }
-    } else { // 48 MHz - HSE
-        if (hz < 350000) {
-            handle->Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_256; // 188 kHz
-        } else if ((hz >= 350000) && (hz < 750000)) {
-            handle->Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_128; // 375 kHz
-        } else if ((hz >= 750000) && (hz < 1000000)) {
-            handle->Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_64; // 750 kHz
-        } else if ((hz >= 1000000) && (hz < 3000000)) {
-            handle->Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_32; // 1.5 MHz (default)
-        } else if ((hz >= 3000000) && (hz < 6000000)) {
-            handle->Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_16; // 3 MHz
-        } else if ((hz >= 6000000) && (hz < 12000000)) {
-            handle->Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_8; // 6 MHz
-        } else if ((hz >= 12000000) && (hz < 24000000)) {
-            handle->Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_4; // 12 MHz
-        } else { // >= 24000000
-            handle->Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_2; // 24 MHz
-        }
+    if (spi_usart(obj)) {
+        spi_usart_format(obj, bits, mode, order);
+        return;
+    }
+
+    SPI_InitTypeDef *init = &SpiHandle[obj->spi.module].Init;
+    spi_format_init(init, obj->spi.module, bits, mode, order);
+    if ((init->CRCCalculation == SPI_CRCCALCULATION_ENABLED) && !spi_crc_supported(init)) {
+        error("SPI%u: %d bit frames not supported with CRC\n", obj->spi.module+1, bits);
     }
 
-    DEBUG_PRINTF("SPI%u: Frequency: %u, 0x%x\n", obj->spi.module+1, hz, (unsigned int)handle->Init.BaudRatePrescaler);
+    DEBUG_PRINTF("SPI%u: Format: %u, %u, %u\n", obj->spi.module+1, bits, mode, order);
 
     init_spi(obj);
 }
 
-uint8_t spi_get_module(spi_t *obj)
+void spi_frequency(spi_t *obj, int hz)
+{
+    if (spi_usart(obj)) {
+        spi_usart_frequency(obj, hz);
+        return;
+    }
+
+    spi_frequency_init(&SpiHandle[obj->spi.module].Init, obj->spi.module, hz);
+
+    DEBUG_PRINTF("SPI%u: Frequency: %u, %u\n", obj->spi.module+1, hz, spi_frequency_actual(obj));
+
+    init_spi(obj);
+}
+
+int spi_crc_enable(spi_t *obj, uint16_t polynomial, int bits)
+{
+    if (spi_usart(obj))
+        return -1;
+
+    SPI_HandleTypeDef *handle = &SpiHandle[obj->spi.module];
+
+    // the generator polynomial is odd, x^0 is always part of it
+    if (!(polynomial & 1) || ((bits != 8) && (bits != 16)) || ((bits == 8) && (polynomial > 0xFF)))
+        return -1;
+
+    // CRCEN would be left out of the registers otherwise
+    SPI_InitTypeDef init = handle->Init;
+    init.CRCLength = (bits == 16) ? SPI_CRC_LENGTH_16BIT : SPI_CRC_LENGTH_8BIT;
+    if (!spi_crc_supported(&init))
+        return -1;
+
+    handle->Init.CRCCalculation = SPI_CRCCALCULATION_ENABLED;
+    handle->Init.CRCPolynomial  = polynomial;
+    handle->Init.CRCLength      = init.CRCLength;
+
+    // CRCPR only changes with the SPI off, CRCEN set from off resets the CRC unit
+    handle->Instance->CR1 &= ~(SPI_CR1_SPE | SPI_CR1_CRCEN);
+    handle->Instance->CRCPR = polynomial;
+
+    DEBUG_PRINTF("SPI%u: CRC: 0x%x, %d\n", obj->spi.module+1, polynomial, bits);
+
+    init_spi(obj);
+
+    return 0;
+}
+
+void spi_crc_disable(spi_t *obj)
+{
+    if (spi_usart(obj))
+        return;
+
+    SpiHandle[obj->spi.module].Init.CRCCalculation = SPI_CRCCALCULATION_DISABLED;
+    init_spi(obj);
+}
+
+int spi_frequency_actual(spi_t *obj)
+{
+    if (spi_usart(obj)) {
+        uint8_t id = obj->spi.module - MODULE_SIZE_SPI;
+        uint32_t brr = SpiUsart[id].instance->BRR;
+        uint32_t div = (brr & 0xFFF0) | ((brr & 0x0007) << 1);
+        return div ? (int)((2 * spi_usart_clock(id)) / div) : 0;
+    }
+
+    SPI_HandleTypeDef *handle = &SpiHandle[obj->spi.module];
+    int i;
+
+    for (i = 0; i < 7; i++) {
+        if (SpiPrescalers[i] == handle->Init.BaudRatePrescaler)
+            break;
+    }
+    return (int)(spi_clock(obj->spi.module) >> (i + 1));
+}
+
+uint8_t spi_get_module(spi_t *obj)
 {
     return obj->spi.module;
 }
@@ -340,12 +1053,12 @@ static inline void ssp_write(spi_t *obj, int value)
     SPI_TypeDef *spi = (SPI_TypeDef *)SpiHandle[obj->spi.module].Instance;
     while (!ssp_writeable(obj));
     //spi->DR = (uint16_t)value;
-    if (handle->Init.DataSize == SPI_DATASIZE_8BIT) {
+    if (!spi_wide_frames(handle)) {
         // Force 8-bit access to the data register
         uint8_t *p_spi_dr = 0;
         p_spi_dr = (uint8_t *) & (spi->DR);
         *p_spi_dr = (uint8_t)value;
-    } else { // SPI_DATASIZE_16BIT
+    } else { // 9 to 16 bits
         spi->DR = (uint16_t)value;
     }
 
@@ -357,7 +1070,7 @@ static inline int ssp_read(spi_t *obj)
     SPI_TypeDef *spi = (SPI_TypeDef *)SpiHandle[obj->spi.module].Instance;
     while (!ssp_readable(obj));
     //return (int)spi->DR;
-    if (handle->Init.DataSize == SPI_DATASIZE_8BIT) {
+    if (!spi_wide_frames(handle)) {
         // Force 8-bit access to the data register
         uint8_t *p_spi_dr = 0;
         p_spi_dr = (uint8_t *) & (spi->DR);
@@ -377,71 +1090,630 @@ static inline int ssp_busy(spi_t *obj)
 
 int spi_master_write(spi_t *obj, int value)
 {
+    if (spi_usart(obj))
+        return spi_usart_master_write(obj, value);
+
+    spi_hardware_cs_begin(obj->spi.module);
     ssp_write(obj, value);
-    return ssp_read(obj);
+    value = ssp_read(obj);
+    spi_hardware_cs_end(obj->spi.module);
+
+    return value;
+}
+
+static int ssp_block_write(spi_t *obj, const char *tx_buffer, int tx_length, char *rx_buffer, int rx_length, char write_fill)
+{
+    int total = (tx_length > rx_length) ? tx_length : rx_length;
+    int i;
+    SPI_HandleTypeDef *handle = &SpiHandle[obj->spi.module];
+    SPI_TypeDef *spi = handle->Instance;
+    bool wide = spi_wide_frames(handle);
+    size_t crc = spi_crc_frames(handle);
+
+    // no frame to append a CRC to
+    if (total <= 0)
+        return 0;
+
+    if (crc) {
+        // one frame at a time, CRCNEXT right after the last one is written
+        int width = wide ? 2 : 1;
+        for (i = 0; i < total; i += width) {
+            uint8_t lo = (i < tx_length) ? (uint8_t)tx_buffer[i] : (uint8_t)write_fill;
+            uint8_t hi = ((i + 1) < tx_length) ? (uint8_t)tx_buffer[i + 1] : (uint8_t)write_fill;
+            ssp_write(obj, wide ? (lo | (hi << 8)) : lo);
+            if ((i + width) >= total) {
+                spi->CR1 |= SPI_CR1_CRCNEXT;
+            }
+            int in = ssp_read(obj);
+            if (i < rx_length) {
+                rx_buffer[i] = (char)(in & 0xFF);
+            }
+            if (wide && ((i + 1) < rx_length)) {
+                rx_buffer[i + 1] = (char)(in >> 8);
+            }
+        }
+        return spi_crc_end(obj->spi.module, crc) ? -1 : total;
+    }
+
+    // bytes per FIFO access: two packed frames of up to 8 bits, or one wider frame;
+    // an odd length ends with a wide frame padded with write_fill
+    int step = 2;
+    int words = wide ? (total + 1) / 2 : total / 2;
+    int sent = 0;
+    int received = 0;
+
+    // RXNE once a whole half-word is in the RX FIFO
+    spi->CR2 &= ~SPI_CR2_FRXTH;
+
+    while (received < words) {
+        // at most 2 half-words in flight, the RX FIFO holds 32 bits
+        if ((sent < words) && ((sent - received) < 2) && (spi->SR & SPI_SR_TXE)) {
+            int offset = sent * step;
+            uint8_t lo = (offset < tx_length) ? (uint8_t)tx_buffer[offset] : (uint8_t)write_fill;
+            uint8_t hi = ((offset + 1) < tx_length) ? (uint8_t)tx_buffer[offset + 1] : (uint8_t)write_fill;
+            spi->DR = (uint16_t)(lo | (hi << 8));
+            sent++;
+        }
+        if (spi->SR & SPI_SR_RXNE) {
+            int offset = received * step;
+            uint16_t data = spi->DR;
+            if (offset < rx_length) {
+                rx_buffer[offset] = (char)(data & 0xFF);
+            }
+            if ((offset + 1) < rx_length) {
+                rx_buffer[offset + 1] = (char)(data >> 8);
+            }
+            received++;
+        }
+    }
+
+    if (!wide) {
+        // back to one frame per byte access
+        spi->CR2 |= SPI_CR2_FRXTH;
+        if (total & 1) {
+            char out = ((total - 1) < tx_length) ? tx_buffer[total - 1] : write_fill;
+            ssp_write(obj, out);
+            char in = (char)ssp_read(obj);
+            if ((total - 1) < rx_length) {
+                rx_buffer[total - 1] = in;
+            }
+        }
+    }
+
+    return total;
+}
+
+int spi_master_block_write(spi_t *obj, const char *tx_buffer, int tx_length, char *rx_buffer, int rx_length, char write_fill)
+{
+    int total = (tx_length > rx_length) ? tx_length : rx_length;
+    int i;
+
+    if (spi_usart(obj)) {
+        for (i = 0; i < total; i++) {
+            char out = (i < tx_length) ? tx_buffer[i] : write_fill;
+            char in = (char)spi_usart_master_write(obj, out);
+            if (i < rx_length) {
+                rx_buffer[i] = in;
+            }
+        }
+        return total;
+    }
+
+    spi_hardware_cs_begin(obj->spi.module);
+    total = ssp_block_write(obj, tx_buffer, tx_length, rx_buffer, rx_length, write_fill);
+    spi_hardware_cs_end(obj->spi.module);
+
+    return total;
 }
 
 int spi_busy(spi_t *obj)
 {
+    if (spi_usart(obj))
+        return !(spi_usart(obj)->instance->ISR & USART_ISR_TC);
+
     return ssp_busy(obj);
 }
 
-/// @returns the number of bytes transferred, or `0` if nothing transferred
-static int spi_master_start_asynch_transfer(spi_t *obj, transfer_type_t transfer_type, void *tx, void *rx, size_t length)
+static void spi_stream_finish(spi_t *obj)
+{
+    SPI_HandleTypeDef *handle = &SpiHandle[obj->spi.module];
+
+    handle->Instance->CR2 &= ~(SPI_CR2_TXEIE | SPI_CR2_RXNEIE | SPI_CR2_ERRIE);
+    SpiStream[obj->spi.module].active = 0;
+}
+
+// The CRC frames follow the last data frame, the RX FIFO must have room for them too
+static inline bool spi_stream_room(spi_stream_t *stream, size_t depth)
+{
+    size_t ahead = ((stream->sent + 1) == stream->total) ? stream->crc : 0;
+    return ((stream->sent - stream->received) + ahead) < depth;
+}
+
+/// Move frames between the FIFOs and the buffers
+/// @returns 1 once the last frame has been received
+static int spi_stream_run(spi_t *obj)
+{
+    SPI_HandleTypeDef *handle = &SpiHandle[obj->spi.module];
+    spi_stream_t *stream = &SpiStream[obj->spi.module];
+    SPI_TypeDef *spi = handle->Instance;
+    bool is16bit = spi_wide_frames(handle);
+    size_t width = is16bit ? 2 : 1;
+    // the RX FIFO holds 32 bits: more frames in flight could overrun it
+    size_t depth = is16bit ? 2 : 4;
+
+    while ((spi->SR & SPI_SR_RXNE) && (stream->received < (stream->total + stream->crc))) {
+        uint16_t data = is16bit ? spi->DR : *(volatile uint8_t *)&spi->DR;
+        // frames beyond the RX buffer are dropped, the CRC frames too
+        if ((stream->received < stream->total) && (obj->rx_buff.pos < obj->rx_buff.length)) {
+            if (is16bit) {
+                *(uint16_t *)((uint8_t *)obj->rx_buff.buffer + obj->rx_buff.pos) = data;
+            } else {
+                ((uint8_t *)obj->rx_buff.buffer)[obj->rx_buff.pos] = (uint8_t)data;
+            }
+            obj->rx_buff.pos += width;
+        }
+        stream->received++;
+    }
+
+    while ((stream->sent < stream->total) && spi_stream_room(stream, depth) && (spi->SR & SPI_SR_TXE)) {
+        // the fill word is clocked out once the TX buffer is exhausted
+        uint16_t data = spi_fill_word;
+        if (obj->tx_buff.pos < obj->tx_buff.length) {
+            if (is16bit) {
+                data = *(const uint16_t *)((const uint8_t *)obj->tx_buff.buffer + obj->tx_buff.pos);
+            } else {
+                data = ((const uint8_t *)obj->tx_buff.buffer)[obj->tx_buff.pos];
+            }
+            obj->tx_buff.pos += width;
+        }
+        if (is16bit) {
+            spi->DR = data;
+        } else {
+            // Force 8-bit access to the data register
+            *(volatile uint8_t *)&spi->DR = (uint8_t)data;
+        }
+        stream->sent++;
+        // the CRC goes out after the last data frame
+        if ((stream->sent == stream->total) && stream->crc) {
+            spi->CR1 |= SPI_CR1_CRCNEXT;
+        }
+    }
+
+    // TXE only matters while TX is not held back by the frames in flight,
+    // RXNE resumes the writes otherwise
+    if ((stream->sent < stream->total) && spi_stream_room(stream, depth)) {
+        spi->CR2 |= SPI_CR2_TXEIE;
+    } else {
+        spi->CR2 &= ~SPI_CR2_TXEIE;
+    }
+
+    return (stream->received == (stream->total + stream->crc));
+}
+
+static void spi_stream_start(spi_t *obj)
 {
-    if (transfer_type != SPI_TRANSFER_TYPE_TX) DEBUG_PRINTF("SPI%u: Start: %u, %u\n", obj->spi.module+1, transfer_type, length);
     SPI_HandleTypeDef *handle = &SpiHandle[obj->spi.module];
-    obj->spi.transfer_type = transfer_type;
+    spi_stream_t *stream = &SpiStream[obj->spi.module];
+    size_t width = spi_wide_frames(handle) ? 2 : 1;
+    size_t length = (obj->tx_buff.length > obj->rx_buff.length) ? obj->tx_buff.length : obj->rx_buff.length;
 
-    bool is16bit = (handle->Init.DataSize == SPI_DATASIZE_16BIT);
-    // the HAL expects number of transfers instead of number of bytes
-    // so for 16 bit transfer width the count needs to be halved
-    size_t words;
-    if (is16bit) words = length / 2;
-    else         words = length;
+    stream->total = length / width;
+    stream->sent = 0;
+    stream->received = 0;
+    stream->crc = spi_crc_frames(handle);
+    stream->active = 1;
 
     // enable the interrupt
-    IRQn_Type irq_n = SpiIRQs[obj->spi.module];
-    vIRQ_EnableIRQ(irq_n);
-
-    // enable the right hal transfer
-    static uint16_t sink;
-    int rc = 0;
-    switch(transfer_type) {
-        case SPI_TRANSFER_TYPE_TXRX:
-            rc = HAL_SPI_TransmitReceive_IT(handle, (uint8_t*)tx, (uint8_t*)rx, words);
-            break;
-        case SPI_TRANSFER_TYPE_TX:
-            // TODO: we do not use `HAL_SPI_Transmit_IT`, since it has some unknown bug
-            // and makes the HAL keep some state and then that fails successive transfers
-            // rc = HAL_SPI_Transmit_IT(handle, (uint8_t*)tx, words);
-            rc = HAL_SPI_TransmitReceive_IT(handle, (uint8_t*)tx, (uint8_t*)&sink, 1);
-            length = is16bit ? 2 : 1;
-            break;
-        case SPI_TRANSFER_TYPE_RX:
-            // the receive function also "transmits" the receive buffer so in order
-            // to guarantee that 0xff is on the line, we explicitly memset it here
-            memset(rx, SPI_FILL_WORD, length);
-            rc = HAL_SPI_Receive_IT(handle, (uint8_t*)rx, words);
-            break;
-        default:
-            length = 0;
+    vIRQ_EnableIRQ(SpiIRQs[obj->spi.module]);
+
+    handle->Instance->CR2 |= SPI_CR2_RXNEIE | SPI_CR2_ERRIE;
+    spi_stream_run(obj);
+}
+
+static uint32_t spi_stream_irq_handler_asynch(spi_t *obj)
+{
+    SPI_HandleTypeDef *handle = &SpiHandle[obj->spi.module];
+    int event = 0;
+
+    if (handle->Instance->SR & (SPI_SR_OVR | SPI_SR_MODF)) {
+        // something went wrong and the transfer has definitely completed
+        event = SPI_EVENT_ERROR | SPI_EVENT_INTERNAL_TRANSFER_COMPLETE;
+        if (handle->Instance->SR & SPI_SR_OVR) {
+            event |= SPI_EVENT_RX_OVERFLOW;
+        }
+        spi_stream_finish(obj);
+        __HAL_SPI_CLEAR_OVRFLAG(handle);
+        __HAL_SPI_CLEAR_MODFFLAG(handle);
+        spi_crc_reset(obj->spi.module);
+    } else if (spi_stream_run(obj)) {
+        // everything is ok, nothing else needs to be transferred
+        spi_stream_finish(obj);
+        event = SPI_EVENT_COMPLETE | SPI_EVENT_INTERNAL_TRANSFER_COMPLETE;
+        if (spi_crc_end(obj->spi.module, 0)) {
+            event = SPI_EVENT_ERROR | SPI_EVENT_CRC_ERROR | SPI_EVENT_INTERNAL_TRANSFER_COMPLETE;
+        }
+        DEBUG_PRINTF("SPI%u: Done: %u, %u\n", obj->spi.module+1, obj->tx_buff.pos, obj->rx_buff.pos);
+    }
+
+    return (event & (obj->spi.event | SPI_EVENT_INTERNAL_TRANSFER_COMPLETE));
+}
+
+static void spi_dma_finish(spi_t *obj)
+{
+    SPI_HandleTypeDef *handle = &SpiHandle[obj->spi.module];
+
+    handle->Instance->CR2 &= ~(SPI_CR2_TXDMAEN | SPI_CR2_RXDMAEN | SPI_CR2_ERRIE);
+    spi_dma_release(&SpiDma[obj->spi.module]);
+    SpiDma[obj->spi.module].active = 0;
+}
+
+/// Start the next chunk: full duplex while both buffers last, then the remainder
+/// of the longer one against the fill word or the sink
+/// @returns 0 if everything was transferred
+static int spi_dma_next(spi_t *obj)
+{
+    SPI_HandleTypeDef *handle = &SpiHandle[obj->spi.module];
+    spi_dma_t *dma = &SpiDma[obj->spi.module];
+    bool is16bit = spi_wide_frames(handle);
+
+    size_t tx_left = obj->tx_buff.length - obj->tx_buff.pos;
+    size_t rx_left = obj->rx_buff.length - obj->rx_buff.pos;
+    size_t bytes;
+
+    if (tx_left && rx_left) {
+        bytes = (tx_left < rx_left) ? tx_left : rx_left;
+    } else {
+        bytes = tx_left ? tx_left : rx_left;
+    }
+
+    size_t words = is16bit ? (bytes / 2) : bytes;
+    if (words == 0)
+        return 0;
+    if (words > 0xFFFF) {
+        words = 0xFFFF;
+    }
+    dma->bytes = is16bit ? (words * 2) : words;
+    dma->tx_used = (tx_left > 0);
+    dma->rx_used = (rx_left > 0);
+
+    // 8 bit frames: byte accesses to DR, FRXTH is set by HAL_SPI_Init, one frame per request
+    uint32_t size = is16bit ? (DMA_CCR_MSIZE_0 | DMA_CCR_PSIZE_0) : 0;
+    const void *tx = dma->tx_used ? (const void *)((uint8_t *)obj->tx_buff.buffer + obj->tx_buff.pos) : (const void *)&spi_fill_word;
+    void *rx = dma->rx_used ? (void *)((uint8_t *)obj->rx_buff.buffer + obj->rx_buff.pos) : (void *)&spi_sink_word;
+
+    // RX first and at a higher priority, it must never fall behind TX
+    dma_channel_start(dma->rx_channel, size | DMA_CCR_TCIE | DMA_CCR_PL_0 | (dma->rx_used ? DMA_CCR_MINC : 0),
+                      &handle->Instance->DR, rx, words);
+    handle->Instance->CR2 |= SPI_CR2_RXDMAEN;
+    dma_channel_start(dma->tx_channel, size | DMA_CCR_DIR | (dma->tx_used ? DMA_CCR_MINC : 0),
+                      &handle->Instance->DR, tx, words);
+    handle->Instance->CR2 |= SPI_CR2_TXDMAEN | SPI_CR2_ERRIE;
+
+    return 1;
+}
+
+/// @returns 1 if the bus has both of its DMA channels
+static int spi_dma_claim(uint8_t module, DMAUsage hint)
+{
+    spi_dma_t *dma = &SpiDma[module];
+
+    if (dma->tx_channel == DMA_CHANNEL_NONE) {
+        dma->tx_channel = dma_channel_claim(SpiTxDmaRequests[module]);
+    }
+    if (dma->rx_channel == DMA_CHANNEL_NONE) {
+        dma->rx_channel = dma_channel_claim(SpiRxDmaRequests[module]);
+    }
+    if ((dma->tx_channel == DMA_CHANNEL_NONE) || (dma->rx_channel == DMA_CHANNEL_NONE)) {
+        dma->keep = 0;
+        spi_dma_release(dma);
+        return 0;
+    }
+    dma->keep = (hint == DMA_USAGE_ALWAYS);
+
+    return 1;
+}
+
+/// @returns 1 if the transfer was started on the DMA channels
+static int spi_dma_transfer(spi_t *obj, uint32_t handler, DMAUsage hint)
+{
+    spi_dma_t *dma = &SpiDma[obj->spi.module];
+
+    if (hint == DMA_USAGE_NEVER)
+        return 0;
+
+    // the SPI sends its CRC when the TX channel count runs out: one chunk only
+    SPI_HandleTypeDef *handle = &SpiHandle[obj->spi.module];
+    if (spi_crc_frames(handle)) {
+        size_t tx_length = obj->tx_buff.length;
+        size_t rx_length = obj->rx_buff.length;
+        size_t frames = ((tx_length > rx_length) ? tx_length : rx_length) / (spi_wide_frames(handle) ? 2 : 1);
+        if ((tx_length && rx_length && (tx_length != rx_length)) || (frames > 0xFFFF))
+            return 0;
+    }
+
+    // no free channel, the caller falls back to the interrupt path
+    if (!spi_dma_claim(obj->spi.module, hint))
+        return 0;
+
+    // the RX channel interrupt reports the end of each chunk
+    IRQn_Type dma_irq_n = dma_channel_irq(dma->rx_channel);
+    vIRQ_SetVector(dma_irq_n, handler);
+    vIRQ_EnableIRQ(dma_irq_n);
+    // OVR and MODF come through the SPI interrupt
+    vIRQ_EnableIRQ(SpiIRQs[obj->spi.module]);
+
+    dma->active = 1;
+    if (!spi_dma_next(obj)) {
+        spi_dma_finish(obj);
+        return 0;
+    }
+
+    DEBUG_PRINTF("SPI%u: Transfer DMA: %u, %u\n", obj->spi.module+1, obj->tx_buff.length, obj->rx_buff.length);
+
+    return 1;
+}
+
+static uint32_t spi_dma_irq_handler_asynch(spi_t *obj)
+{
+    SPI_HandleTypeDef *handle = &SpiHandle[obj->spi.module];
+    spi_dma_t *dma = &SpiDma[obj->spi.module];
+    int event = 0;
+
+    if (handle->Instance->SR & (SPI_SR_OVR | SPI_SR_MODF)) {
+        // something went wrong and the transfer has definitely completed
+        event = SPI_EVENT_ERROR | SPI_EVENT_INTERNAL_TRANSFER_COMPLETE;
+        if (handle->Instance->SR & SPI_SR_OVR) {
+            event |= SPI_EVENT_RX_OVERFLOW;
+        }
+        spi_dma_finish(obj);
+        __HAL_SPI_CLEAR_OVRFLAG(handle);
+        __HAL_SPI_CLEAR_MODFFLAG(handle);
+        spi_crc_reset(obj->spi.module);
+    } else if (dma_channel_flags(dma->rx_channel) & DMA_CHANNEL_FLAG_TC) {
+        dma_channel_clear(dma->rx_channel, DMA_CHANNEL_FLAG_GI | DMA_CHANNEL_FLAG_TC);
+        // the last frame of the chunk is in, so it is out too
+        if (dma->tx_used) {
+            obj->tx_buff.pos += dma->bytes;
+        }
+        if (dma->rx_used) {
+            obj->rx_buff.pos += dma->bytes;
+        }
+        if (!spi_dma_next(obj)) {
+            spi_dma_finish(obj);
+            event = SPI_EVENT_COMPLETE | SPI_EVENT_INTERNAL_TRANSFER_COMPLETE;
+            // the RX channel stops at the data, the CRC frames are left in the FIFO
+            if (spi_crc_end(obj->spi.module, spi_crc_frames(handle))) {
+                event = SPI_EVENT_ERROR | SPI_EVENT_CRC_ERROR | SPI_EVENT_INTERNAL_TRANSFER_COMPLETE;
+            }
+            DEBUG_PRINTF("SPI%u: Done DMA: %u, %u\n", obj->spi.module+1, obj->tx_buff.pos, obj->rx_buff.pos);
+        }
+    }
+
+    return (event & (obj->spi.event | SPI_EVENT_INTERNAL_TRANSFER_COMPLETE));
+}
+
+#if DEVICE_SPISLAVE
+static void spi_slave_finish(spi_t *obj)
+{
+    SPI_HandleTypeDef *handle = &SpiHandle[obj->spi.module];
+    spi_slave_t *slave = &SpiSlave[obj->spi.module];
+
+    handle->Instance->CR2 &= ~(SPI_CR2_TXDMAEN | SPI_CR2_RXDMAEN | SPI_CR2_ERRIE);
+    spi_dma_release(&SpiDma[obj->spi.module]);
+    slave->active = 0;
+
+    // drop the reply frames left in the TX FIFO, the next transfer starts clean
+    spi_reset(obj->spi.module);
+    __HAL_SPI_ENABLE(handle);
+}
+
+static void spi_slave_rx_start(spi_t *obj)
+{
+    SPI_HandleTypeDef *handle = &SpiHandle[obj->spi.module];
+    spi_slave_t *slave = &SpiSlave[obj->spi.module];
+    bool is16bit = spi_wide_frames(handle);
+    uint32_t size = is16bit ? (DMA_CCR_MSIZE_0 | DMA_CCR_PSIZE_0) : 0;
+    size_t frames = obj->rx_buff.length / (is16bit ? 2 : 1);
+
+    slave->rx_sink = slave->rx_sink || (frames == 0);
+    if (slave->rx_sink) {
+        // whatever the master clocks past the buffer
+        slave->rx_count = 0xFFFF;
+        dma_channel_start(SpiDma[obj->spi.module].rx_channel, size | DMA_CCR_TCIE | DMA_CCR_PL_1,
+                          &handle->Instance->DR, &spi_sink_word, slave->rx_count);
+    } else {
+        slave->rx_count = (uint16_t)frames;
+        dma_channel_start(SpiDma[obj->spi.module].rx_channel, size | DMA_CCR_TCIE | DMA_CCR_PL_1 | DMA_CCR_MINC,
+                          &handle->Instance->DR, obj->rx_buff.buffer, slave->rx_count);
+    }
+}
+
+static void spi_slave_tx_start(spi_t *obj)
+{
+    SPI_HandleTypeDef *handle = &SpiHandle[obj->spi.module];
+    spi_slave_t *slave = &SpiSlave[obj->spi.module];
+    bool is16bit = spi_wide_frames(handle);
+    uint32_t size = is16bit ? (DMA_CCR_MSIZE_0 | DMA_CCR_PSIZE_0) : 0;
+    size_t frames = obj->tx_buff.length / (is16bit ? 2 : 1);
+
+    slave->tx_fill = slave->tx_fill || (frames == 0);
+    if (slave->tx_fill) {
+        dma_channel_start(SpiDma[obj->spi.module].tx_channel, size | DMA_CCR_DIR | DMA_CCR_TCIE | DMA_CCR_PL_0,
+                          &handle->Instance->DR, &spi_fill_word, 0xFFFF);
+    } else {
+        dma_channel_start(SpiDma[obj->spi.module].tx_channel, size | DMA_CCR_DIR | DMA_CCR_TCIE | DMA_CCR_PL_0 | DMA_CCR_MINC,
+                          &handle->Instance->DR, obj->tx_buff.buffer, frames);
     }
+}
+
+static void spi_slave_nss_irq(uint32_t id, gpio_irq_event event)
+{
+    spi_t *obj = (spi_t *)id;
+    spi_slave_t *slave = &SpiSlave[obj->spi.module];
+
+    if ((event != IRQ_RISE) || !slave->active)
+        return;
 
-    if (rc) {
-        DEBUG_PRINTF("SPI%u: RC=%u\n", obj->spi.module+1, rc);
-        length = 0;
+    // the master is done: report through the asynch handler
+    slave->ended = 1;
+    ((void (*)(void))slave->handler)();
+}
+
+static uint32_t spi_slave_irq_handler_asynch(spi_t *obj)
+{
+    SPI_HandleTypeDef *handle = &SpiHandle[obj->spi.module];
+    spi_dma_t *dma = &SpiDma[obj->spi.module];
+    spi_slave_t *slave = &SpiSlave[obj->spi.module];
+    size_t width = spi_wide_frames(handle) ? 2 : 1;
+    int event = 0;
+
+    if (handle->Instance->SR & (SPI_SR_OVR | SPI_SR_MODF)) {
+        event = SPI_EVENT_ERROR | SPI_EVENT_INTERNAL_TRANSFER_COMPLETE;
+        if (handle->Instance->SR & SPI_SR_OVR) {
+            event |= SPI_EVENT_RX_OVERFLOW;
+        }
+        spi_slave_finish(obj);
+        return (event & (obj->spi.event | SPI_EVENT_INTERNAL_TRANSFER_COMPLETE));
     }
 
-    return length;
+    // the TX FIFO still holds the last frames of a chunk: a few frame times to reload
+    if (dma_channel_flags(dma->tx_channel) & DMA_CHANNEL_FLAG_TC) {
+        dma_channel_clear(dma->tx_channel, DMA_CHANNEL_FLAG_GI | DMA_CHANNEL_FLAG_TC);
+        slave->tx_fill = 1;
+        spi_slave_tx_start(obj);
+    }
+    if (dma_channel_flags(dma->rx_channel) & DMA_CHANNEL_FLAG_TC) {
+        dma_channel_clear(dma->rx_channel, DMA_CHANNEL_FLAG_GI | DMA_CHANNEL_FLAG_TC);
+        slave->frames += slave->rx_count;
+        slave->rx_sink = 1;
+        spi_slave_rx_start(obj);
+    }
+
+    if (slave->ended) {
+        size_t bytes = (slave->frames + slave->rx_count - dma_channel_remaining(dma->rx_channel)) * width;
+        obj->rx_buff.pos = (bytes < obj->rx_buff.length) ? bytes : obj->rx_buff.length;
+        obj->tx_buff.pos = (bytes < obj->tx_buff.length) ? bytes : obj->tx_buff.length;
+        spi_slave_finish(obj);
+        event = SPI_EVENT_COMPLETE | SPI_EVENT_INTERNAL_TRANSFER_COMPLETE;
+        DEBUG_PRINTF("SPI%u: Slave done: %u\n", obj->spi.module+1, bytes);
+    }
+
+    return (event & (obj->spi.event | SPI_EVENT_INTERNAL_TRANSFER_COMPLETE));
 }
 
+int spi_slave_init(spi_t *obj, PinName ssel)
+{
+    if (spi_usart(obj))
+        return -1;
+
+    SPI_HandleTypeDef *handle = &SpiHandle[obj->spi.module];
+    spi_slave_t *slave = &SpiSlave[obj->spi.module];
+
+    if ((SPIName)pinmap_peripheral(ssel, PinMap_SPI_SSEL) != (SPIName)handle->Instance)
+        return -1;
+
+    // the EXTI line follows the pin on its alternate function too: the
+    // GPIO interrupt is set up first, the SPI takes the pin back after it
+    if (!slave->enabled) {
+        if (gpio_irq_init(&slave->nss, ssel, spi_slave_nss_irq, (uint32_t)obj) != 0)
+            return -1;
+        gpio_irq_set(&slave->nss, IRQ_RISE, 1);
+        slave->enabled = 1;
+    }
+    pinmap_pinout(ssel, PinMap_SPI_SSEL);
+    obj->spi.pin_ssel = ssel;
+
+    handle->Init.Mode = SPI_MODE_SLAVE;
+    handle->Init.NSS  = SPI_NSS_HARD_INPUT;
+    spi_reset(obj->spi.module);
+    __HAL_SPI_ENABLE(handle);
+
+    DEBUG_PRINTF("SPI%u: Slave\n", obj->spi.module+1);
+
+    return 0;
+}
+
+int spi_slave_transfer(spi_t *obj, const void *tx, size_t tx_length, void *rx, size_t rx_length, uint32_t handler, uint32_t event, DMAUsage hint)
+{
+    SPI_HandleTypeDef *handle = &SpiHandle[obj->spi.module];
+    spi_dma_t *dma = &SpiDma[obj->spi.module];
+    spi_slave_t *slave = &SpiSlave[obj->spi.module];
+
+    size_t width = spi_wide_frames(handle) ? 2 : 1;
+
+    if (spi_usart(obj) || !slave->enabled || slave->active)
+        return -1;
+    // each buffer takes a single DMA chunk
+    if (((tx_length / width) > 0xFFFF) || ((rx_length / width) > 0xFFFF))
+        return -1;
+    // an interrupt per frame cannot keep up with the master clock
+    if ((hint == DMA_USAGE_NEVER) || !spi_dma_claim(obj->spi.module, hint))
+        return -1;
+
+    obj->tx_buff.buffer = (void *)tx;
+    obj->tx_buff.length = tx ? tx_length : 0;
+    obj->tx_buff.pos = 0;
+    obj->tx_buff.width = width * 8;
+    obj->rx_buff.buffer = rx;
+    obj->rx_buff.length = rx ? rx_length : 0;
+    obj->rx_buff.pos = 0;
+    obj->rx_buff.width = obj->tx_buff.width;
+    obj->spi.event = event;
+
+    slave->handler = handler;
+    slave->frames = 0;
+    slave->tx_fill = 0;
+    slave->rx_sink = 0;
+    slave->ended = 0;
+
+    vIRQ_SetVector(SpiIRQs[obj->spi.module], handler);
+    vIRQ_EnableIRQ(SpiIRQs[obj->spi.module]);
+    vIRQ_SetVector(dma_channel_irq(dma->tx_channel), handler);
+    vIRQ_EnableIRQ(dma_channel_irq(dma->tx_channel));
+    vIRQ_SetVector(dma_channel_irq(dma->rx_channel), handler);
+    vIRQ_EnableIRQ(dma_channel_irq(dma->rx_channel));
+
+    // RXDMAEN, the channels, TXDMAEN, then SPE: the TX channel fills the TX FIFO
+    // right away and the reply is out from the first clock of the master
+    spi_reset(obj->spi.module);
+    handle->Instance->CR2 |= SPI_CR2_RXDMAEN;
+    spi_slave_rx_start(obj);
+    spi_slave_tx_start(obj);
+    handle->Instance->CR2 |= SPI_CR2_TXDMAEN | SPI_CR2_ERRIE;
+    slave->active = 1;
+    __HAL_SPI_ENABLE(handle);
+
+    DEBUG_PRINTF("SPI%u: Slave transfer: %u, %u\n", obj->spi.module+1, tx_length, rx_length);
+
+    return 0;
+}
+
+int spi_slave_receive(spi_t *obj)
+{
+    if (spi_usart(obj))
+        return 0;
+    return ssp_readable(obj);
+}
+
+// A synchronous USART is a master only: nothing is ever received nor sent as slave
+int spi_slave_read(spi_t *obj)
+{
+    if (spi_usart(obj))
+        return 0;
+    return ssp_read(obj);
+}
+
+void spi_slave_write(spi_t *obj, int value)
+{
+    if (spi_usart(obj))
+        return;
+    ssp_write(obj, value);
+}
+#endif
+
 // asynchronous API
 void spi_master_transfer(spi_t *obj, void *tx, size_t tx_length, void *rx, size_t rx_length, uint32_t handler, uint32_t event, DMAUsage hint)
 {
-    // TODO: DMA usage is currently ignored
-    (void) hint;
-
     // check which use-case we have
     bool use_tx = (tx != NULL && tx_length > 0);
     bool use_rx = (rx != NULL && rx_length > 0);
@@ -452,132 +1724,320 @@ void spi_master_transfer(spi_t *obj, void *tx, size_t tx_length, void *rx, size_
 
     SPI_HandleTypeDef *handle = &SpiHandle[obj->spi.module];
 
-    bool is16bit = (handle->Init.DataSize == SPI_DATASIZE_16BIT);
+    bool is16bit = spi_usart(obj) ? false : spi_wide_frames(handle);
 
     // copy the buffers to the SPI object
     obj->tx_buff.buffer = tx;
-    obj->tx_buff.length = tx_length;
+    obj->tx_buff.length = use_tx ? tx_length : 0;
     obj->tx_buff.pos = 0;
     obj->tx_buff.width = is16bit ? 16 : 8;
 
     obj->rx_buff.buffer = rx;
-    obj->rx_buff.length = rx_length;
+    obj->rx_buff.length = use_rx ? rx_length : 0;
     obj->rx_buff.pos = 0;
     obj->rx_buff.width = obj->tx_buff.width;
 
     obj->spi.event = event;
 
+    if (spi_usart(obj)) {
+        spi_usart_master_transfer(obj, handler, hint);
+        return;
+    }
+
     DEBUG_PRINTF("SPI%u: Transfer: %u, %u\n", obj->spi.module+1, tx_length, rx_length);
 
     // register the thunking handler
     IRQn_Type irq_n = SpiIRQs[obj->spi.module];
     vIRQ_SetVector(irq_n, handler);
 
-    // enable the right hal transfer
-    if (use_tx && use_rx) {
-        // transfer with the min(tx, rx), then later either transmit _or_ receive the remainder
-        size_t size = (tx_length < rx_length)? tx_length : rx_length;
-        spi_master_start_asynch_transfer(obj, SPI_TRANSFER_TYPE_TXRX, tx, rx, size);
-    } else if (use_tx) {
-        spi_master_start_asynch_transfer(obj, SPI_TRANSFER_TYPE_TX, tx, NULL, tx_length);
-    } else if (use_rx) {
-        spi_master_start_asynch_transfer(obj, SPI_TRANSFER_TYPE_RX, NULL, rx, rx_length);
-    }
+    spi_hardware_cs_begin(obj->spi.module);
+
+    if (spi_dma_transfer(obj, handler, hint))
+        return;
+
+    spi_stream_start(obj);
 }
 
 uint32_t spi_irq_handler_asynch(spi_t *obj)
 {
-    // use the right instance
-    SPI_HandleTypeDef *handle = &SpiHandle[obj->spi.module];
-    int event = 0;
+    uint32_t event = 0;
 
-    // call the CubeF4 handler, this will update the handle
-    HAL_SPI_IRQHandler(handle);
-
-    if (HAL_SPI_GetState(handle) == HAL_SPI_STATE_READY) {
-        // adjust buffer positions
-        size_t tx_size = (handle->TxXferSize - handle->TxXferCount);
-        size_t rx_size = (handle->RxXferSize - handle->RxXferCount);
-        // 16 bit transfers need to be doubled to get bytes
-        if (handle->Init.DataSize == SPI_DATASIZE_16BIT) {
-            tx_size *= 2;
-            rx_size *= 2;
-        }
-        // adjust buffer positions
-        if (obj->spi.transfer_type != SPI_TRANSFER_TYPE_RX) {
-            obj->tx_buff.pos += tx_size;
-        }
-        if (obj->spi.transfer_type != SPI_TRANSFER_TYPE_TX) {
-            obj->rx_buff.pos += rx_size;
-        }
+    if (spi_usart(obj))
+        return spi_usart_irq_handler_asynch(obj);
+#if DEVICE_SPISLAVE
+    if (SpiSlave[obj->spi.module].active)
+        return spi_slave_irq_handler_asynch(obj);
+#endif
+    if (SpiDma[obj->spi.module].active) {
+        event = spi_dma_irq_handler_asynch(obj);
+    } else if (SpiStream[obj->spi.module].active) {
+        event = spi_stream_irq_handler_asynch(obj);
+    }
 
-        if (handle->TxXferCount > 0) DEBUG_PRINTF("SPI%u: TxXferCount: %u\n", obj->spi.module+1, handle->TxXferCount);
-        if (handle->RxXferCount > 0) DEBUG_PRINTF("SPI%u: RxXferCount: %u\n", obj->spi.module+1, handle->RxXferCount);
+    if (event & SPI_EVENT_INTERNAL_TRANSFER_COMPLETE) {
+        spi_hardware_cs_end(obj->spi.module);
+    }
+    return event;
+}
 
-        int error = HAL_SPI_GetError(handle);
-        if(error != HAL_SPI_ERROR_NONE) {
-            // something went wrong and the transfer has definitely completed
-            event = SPI_EVENT_ERROR | SPI_EVENT_INTERNAL_TRANSFER_COMPLETE;
+uint8_t spi_active(spi_t *obj)
+{
+    if (spi_usart(obj))
+        return spi_usart(obj)->active ? -1 : 0;
+    if (SpiDma[obj->spi.module].active || SpiStream[obj->spi.module].active)
+        return -1;
+#if DEVICE_SPISLAVE
+    if (SpiSlave[obj->spi.module].active)
+        return -1;
+#endif
+    return 0;
+}
 
-            if (error & HAL_SPI_ERROR_OVR) {
-                // buffer overrun
-                event |= SPI_EVENT_RX_OVERFLOW;
-            }
-        } else {
-            // figure out if we need to transfer more data:
-            if (obj->tx_buff.pos < obj->tx_buff.length) {
-                // DEBUG_PRINTF("t%u ", obj->tx_buff.pos);
-                // we need to transfer more data
-                spi_master_start_asynch_transfer(obj, SPI_TRANSFER_TYPE_TX,
-                    obj->tx_buff.buffer + obj->tx_buff.pos,     // offset the initial buffer by the position
-                    NULL,                                       // there is no receive buffer
-                    obj->tx_buff.length - obj->tx_buff.pos);    // transfer the remaining bytes only
-            } else if (obj->rx_buff.pos < obj->rx_buff.length) {
-                // DEBUG_PRINTF("r%u ", obj->rx_buff.pos);
-                // we need to receive more data
-                spi_master_start_asynch_transfer(obj, SPI_TRANSFER_TYPE_RX,
-                    NULL,                                       // there is no transmit buffer
-                    obj->rx_buff.buffer + obj->rx_buff.pos,     // offset the initial buffer by the position
-                    obj->rx_buff.length - obj->rx_buff.pos);    // transfer one byte at a time, until we received everything
-            } else {
-                // everything is ok, nothing else needs to be transferred
-                event = SPI_EVENT_COMPLETE | SPI_EVENT_INTERNAL_TRANSFER_COMPLETE;
-                DEBUG_PRINTF("SPI%u: Done: %u, %u\n", obj->spi.module+1, obj->tx_buff.pos, obj->rx_buff.pos);
-            }
+void spi_abort_asynch(spi_t *obj)
+{
+    if (spi_usart(obj)) {
+        spi_usart_abort_asynch(obj);
+        return;
+    }
+
+    // diable interrupt
+    vIRQ_DisableIRQ(SpiIRQs[obj->spi.module]);
+
+#if DEVICE_SPISLAVE
+    if (SpiSlave[obj->spi.module].active) {
+        spi_slave_finish(obj);
+        return;
+    }
+#endif
+
+    // stop the DMA channels, if any
+    if (SpiDma[obj->spi.module].active) {
+        spi_dma_finish(obj);
+    }
+    spi_stream_finish(obj);
+
+    // clean-up with the disabling procedure of the reference manual: with the
+    // requests gone, at most a FIFO of frames is left to clock out
+    SPI_HandleTypeDef *handle = &SpiHandle[obj->spi.module];
+    SPI_TypeDef *spi = handle->Instance;
+    if (!(spi->CR1 & SPI_CR1_SPE)) {
+        // off (hardware CS, MODF): nothing clocks the TX FIFO out
+        if (spi->SR & SPI_SR_FTLVL) {
+            spi_reset(obj->spi.module);
         }
+    } else {
+        while (spi->SR & SPI_SR_FTLVL);
+        while (spi->SR & SPI_SR_BSY);
+    }
+    __HAL_SPI_DISABLE(handle);
+    while (spi->SR & SPI_SR_FRLVL) {
+        (void)*(volatile uint8_t *)&spi->DR;
     }
+    __HAL_SPI_CLEAR_OVRFLAG(handle);
+    // MODF also clears MSTR, init_spi() below puts it back
+    __HAL_SPI_CLEAR_MODFFLAG(handle);
+    spi_crc_reset(obj->spi.module);
 
-    if (event) DEBUG_PRINTF("SPI%u: Event: 0x%x\n", obj->spi.module+1, event);
+    // the configuration is still in place, only what MODF changed is rewritten
+    init_spi(obj);
+}
 
-    return (event & (obj->spi.event | SPI_EVENT_INTERNAL_TRANSFER_COMPLETE));
+/******************************************************************************
+ * TRANSACTION QUEUE
+ ******************************************************************************/
+
+static void spi_queue_start(uint8_t module);
+
+static void spi_queue_irq(uint8_t module)
+{
+    spi_queue_t *queue = &SpiQueue[module];
+    SPI_HandleTypeDef *handle = &SpiHandle[module];
+    spi_transaction_t *done = queue->head;
+
+    uint32_t event = spi_irq_handler_asynch(queue->obj);
+    if (!(event & SPI_EVENT_INTERNAL_TRANSFER_COMPLETE) || (done == NULL))
+        return;
+
+    // the last frame is in, wait for the clock to settle before releasing the device
+    // (the NSS output is already released by spi_irq_handler_asynch())
+    while (__HAL_SPI_GET_FLAG(handle, SPI_FLAG_BSY) != RESET);
+    if (!queue->hardware_cs && done->cs) {
+        gpio_write(done->cs, 1);
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    queue->head = done->next;
+    if (queue->head == NULL) {
+        queue->tail = NULL;
+    }
+    __set_PRIMASK(primask);
+
+    // the bus goes on before the callback runs
+    if (queue->head) {
+        spi_queue_start(module);
+    }
+
+    if (done->callback) {
+        done->callback(done, event & (SPI_EVENT_ALL | SPI_EVENT_CRC_ERROR));
+    }
 }
 
-uint8_t spi_active(spi_t *obj)
+static void spi1_queue_irq(void)
 {
-    SPI_HandleTypeDef *handle = &SpiHandle[obj->spi.module];
-    HAL_SPI_StateTypeDef state = HAL_SPI_GetState(handle);
+    spi_queue_irq(0);
+}
 
-    switch(state) {
-        case HAL_SPI_STATE_RESET:
-        case HAL_SPI_STATE_READY:
-        case HAL_SPI_STATE_ERROR:
-            return 0;
-        default:
-            return -1;
+static void spi2_queue_irq(void)
+{
+    spi_queue_irq(1);
+}
+
+static void spi3_queue_irq(void)
+{
+    spi_queue_irq(2);
+}
+
+static const uint32_t spi_queue_vectors[MODULE_SIZE_SPI] = {
+    (uint32_t)&spi1_queue_irq,
+    (uint32_t)&spi2_queue_irq,
+    (uint32_t)&spi3_queue_irq,
+};
+
+static void spi_profile_apply(spi_t *obj, const spi_profile_t *profile)
+{
+    if (profile->cr1 == 0) {
+        // not prepared, MSTR is always set in the image
+        spi_format(obj, profile->bits, profile->mode, profile->order);
+        spi_frequency(obj, profile->hz);
+        return;
     }
+
+    // keep the handle in line with the registers, the transfers read the frame size from it
+    SPI_InitTypeDef *init = &SpiHandle[obj->spi.module].Init;
+    init->DataSize          = profile->cr2 & SPI_CR2_DS;
+    init->CLKPolarity       = profile->cr1 & SPI_CR1_CPOL;
+    init->CLKPhase          = profile->cr1 & SPI_CR1_CPHA;
+    init->FirstBit          = profile->cr1 & SPI_CR1_LSBFIRST;
+    init->BaudRatePrescaler = profile->cr1 & SPI_CR1_BR;
+
+    spi_config_write(obj->spi.module, profile->cr1, profile->cr2);
 }
 
-void spi_abort_asynch(spi_t *obj)
+static void spi_queue_start(uint8_t module)
 {
-    // diable interrupt
-    vIRQ_DisableIRQ(SpiIRQs[obj->spi.module]);
+    spi_queue_t *queue = &SpiQueue[module];
+    spi_transaction_t *transaction = queue->head;
+    spi_t *obj = queue->obj;
+
+    // unchanged settings leave the registers alone
+    if (transaction->profile) {
+        spi_profile_apply(obj, transaction->profile);
+    }
+
+    // the NSS output is asserted by spi_master_transfer()
+    if (!queue->hardware_cs && transaction->cs) {
+        gpio_write(transaction->cs, 0);
+    }
+
+    spi_master_transfer(obj, (void *)transaction->tx, transaction->tx_length, transaction->rx, transaction->rx_length,
+                        spi_queue_vectors[module], SPI_EVENT_ALL | SPI_EVENT_CRC_ERROR, queue->hint);
+}
+
+int spi_transaction_queue(spi_t *obj, spi_transaction_t *transaction, DMAUsage hint)
+{
+    if (spi_usart(obj) || (SpiHandle[obj->spi.module].Init.Mode == SPI_MODE_SLAVE))
+        return -1;
+    // nothing to clock, no interrupt would ever end it
+    if (!(transaction->tx && transaction->tx_length) && !(transaction->rx && transaction->rx_length))
+        return -1;
+
+    spi_queue_t *queue = &SpiQueue[obj->spi.module];
+    bool idle;
+
+    transaction->next = NULL;
+
+    // transactions can be queued from thread and interrupt context alike
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    idle = (queue->head == NULL);
+    if (idle) {
+        queue->obj = obj;
+        queue->hint = hint;
+        queue->head = transaction;
+    } else {
+        queue->tail->next = transaction;
+    }
+    queue->tail = transaction;
+    __set_PRIMASK(primask);
+
+    if (idle) {
+        spi_queue_start(obj->spi.module);
+    }
+
+    return 0;
+}
+
+int spi_profile_prepare(spi_t *obj, spi_profile_t *profile)
+{
+    if (spi_usart(obj))
+        return -1;
+
+    // the settings of the bus with the ones of the profile on top
+    SPI_InitTypeDef init = SpiHandle[obj->spi.module].Init;
+    spi_format_init(&init, obj->spi.module, profile->bits, profile->mode, profile->order);
+    if ((init.CRCCalculation == SPI_CRCCALCULATION_ENABLED) && !spi_crc_supported(&init))
+        return -1;
+    spi_frequency_init(&init, obj->spi.module, profile->hz);
+    spi_config_image(&init, &profile->cr1, &profile->cr2);
+
+    return 0;
+}
+
+int spi_transaction_hardware_cs(spi_t *obj, PinName ssel, int pulse)
+{
+    if (spi_usart(obj))
+        return -1;
 
-    // clean-up
     SPI_HandleTypeDef *handle = &SpiHandle[obj->spi.module];
-    __HAL_SPI_DISABLE(handle);
-    HAL_SPI_DeInit(handle);
-    HAL_SPI_Init(handle);
-    __HAL_SPI_ENABLE(handle);
+    if ((SPIName)pinmap_peripheral(ssel, PinMap_SPI_SSEL) != (SPIName)handle->Instance)
+        return -1;
+
+    pinmap_pinout(ssel, PinMap_SPI_SSEL);
+    obj->spi.pin_ssel = ssel;
+
+    // NSS follows SPE, NSSP also pulses it between the frames (CPHA = 0 only)
+    handle->Init.NSS = SPI_NSS_HARD_OUTPUT;
+    handle->Init.NSSPMode = pulse ? SPI_NSS_PULSE_ENABLE : SPI_NSS_PULSE_DISABLE;
+    SpiQueue[obj->spi.module].hardware_cs = 1;
+
+    init_spi(obj);
+
+    return 0;
+}
+
+int spi_transaction_software_cs(spi_t *obj)
+{
+    if (spi_usart(obj))
+        return -1;
+
+    SPI_HandleTypeDef *handle = &SpiHandle[obj->spi.module];
+    if (!SpiQueue[obj->spi.module].hardware_cs)
+        return 0;
+    if (SpiQueue[obj->spi.module].head != NULL)
+        return -1;
+
+    // the NSS pin goes back to an input, the SPI stays enabled between transfers
+    handle->Init.NSS = SPI_NSS_SOFT;
+    handle->Init.NSSPMode = SPI_NSS_PULSE_DISABLE;
+    SpiQueue[obj->spi.module].hardware_cs = 0;
+
+    init_spi(obj);
+
+    pin_function(obj->spi.pin_ssel, STM_PIN_DATA(STM_MODE_INPUT, GPIO_NOPULL, 0));
+    obj->spi.pin_ssel = NC;
+
+    return 0;
 }
 
 #endif
@@ -0,0 +1,240 @@
+/* mbed Microcontroller Library
+ *******************************************************************************
+ * Copyright (c) 2015, STMicroelectronics
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of STMicroelectronics nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************
+ */
+// Host test of the DMA channel allocator against fake DMA1/DMA2 register blocks.
+// The "hardware" is driven by hand: fake_dma_sync() applies IFCR writes to ISR and
+// fake_dma_run() performs a memory to peripheral transfer the way a USART TX
+// request would, then raises the completion flags.
+#include <stdio.h>
+#include <string.h>
+
+#include "cmsis.h"
+#include "dma_channel.h"
+
+fake_dma_t fake_dma1;
+fake_dma_t fake_dma2;
+uint32_t fake_primask;
+
+static int failures;
+
+#define CHECK(expr) do { \
+        if (!(expr)) { \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr); \
+            failures++; \
+        } \
+    } while (0)
+
+static fake_dma_t *fake_dma(int channel)
+{
+    return (channel <= 7) ? &fake_dma1 : &fake_dma2;
+}
+
+static uint8_t fake_shift(int channel)
+{
+    return (uint8_t)(((channel - 1) % 7) * 4);
+}
+
+// IFCR is write-only: CGIFx clears every flag of channel x, the others their own flag
+static void fake_dma_sync(fake_dma_t *dma)
+{
+    uint32_t clear = dma->regs.IFCR;
+    int shift;
+
+    for (shift = 0; shift < 28; shift += 4) {
+        if (clear & (DMA_IFCR_CGIF1 << shift)) {
+            clear |= 0xFU << shift;
+        }
+    }
+    dma->regs.ISR &= ~clear;
+    dma->regs.IFCR = 0;
+}
+
+// Move the programmed items into a fake data register, one write per item
+static void fake_dma_run(int channel, uint8_t *tdr_log)
+{
+    DMA_Channel_TypeDef *regs = dma_channel_instance(channel);
+    const uint8_t *mem = (const uint8_t *)(uintptr_t)regs->CMAR;
+    uint32_t i = 0;
+
+    if (!(regs->CCR & DMA_CCR_EN))
+        return;
+    while (regs->CNDTR) {
+        tdr_log[i] = mem[(regs->CCR & DMA_CCR_MINC) ? i : 0];
+        i++;
+        regs->CNDTR--;
+    }
+    fake_dma(channel)->regs.ISR |= (DMA_ISR_GIF1 | DMA_ISR_TCIF1) << fake_shift(channel);
+}
+
+static void reset(void)
+{
+    int channel;
+
+    for (channel = 1; channel <= DMA_CHANNEL_NUM; channel++) {
+        dma_channel_release(channel);
+    }
+    memset(&fake_dma1, 0, sizeof(fake_dma1));
+    memset(&fake_dma2, 0, sizeof(fake_dma2));
+    fake_primask = 0;
+}
+
+static uint32_t cselr_of(int channel)
+{
+    return (fake_dma(channel)->cselr.CSELR >> fake_shift(channel)) & 0xFU;
+}
+
+static void test_routing(void)
+{
+    reset();
+
+    // USART1_TX: DMA1 channel 4, request 2
+    int channel = dma_channel_claim(DMA_REQ_USART1_TX);
+    CHECK(channel == 4);
+    CHECK(dma_channel_instance(channel) == DMA1_Channel4);
+    CHECK(dma_channel_irq(channel) == DMA1_Channel4_IRQn);
+    CHECK(cselr_of(channel) == 2);
+    CHECK(fake_dma1.clock == 1);
+    CHECK(fake_dma2.clock == 0);
+    // the other channels of the controller keep their selection
+    CHECK((fake_dma1.cselr.CSELR & ~(0xFU << 12)) == 0);
+    CHECK(fake_primask == 0);
+
+    // LPUART1_TX: DMA2 channel 6, request 4
+    channel = dma_channel_claim(DMA_REQ_LPUART1_TX);
+    CHECK(channel == 13);
+    CHECK(dma_channel_instance(channel) == DMA2_Channel6);
+    CHECK(dma_channel_irq(channel) == DMA2_Channel6_IRQn);
+    CHECK(cselr_of(channel) == 4);
+    CHECK(fake_dma2.clock == 1);
+}
+
+static void test_fallback(void)
+{
+    reset();
+
+    // SPI2_RX holds DMA1 channel 4, USART1_TX moves to DMA2 channel 6
+    CHECK(dma_channel_claim(DMA_REQ_SPI2_RX) == 4);
+    CHECK(cselr_of(4) == 1);
+    int channel = dma_channel_claim(DMA_REQ_USART1_TX);
+    CHECK(channel == 13);
+    CHECK(cselr_of(channel) == 2);
+
+    // both routes taken
+    CHECK(dma_channel_claim(DMA_REQ_USART1_TX) == DMA_CHANNEL_NONE);
+    // a single route request stays out as well
+    CHECK(dma_channel_claim(DMA_REQ_LPUART1_TX) == DMA_CHANNEL_NONE);
+
+    // released channels are routed again, with the new selector
+    dma_channel_release(4);
+    CHECK(dma_channel_claim(DMA_REQ_USART1_TX) == 4);
+    CHECK(cselr_of(4) == 2);
+
+    dma_channel_release(13);
+    CHECK(dma_channel_claim(DMA_REQ_LPUART1_TX) == 13);
+    CHECK(cselr_of(13) == 4);
+}
+
+static void test_route_table(void)
+{
+    int request;
+
+    // every request gets a channel on an idle controller, its IRQ matches its registers
+    for (request = 0; request < DMA_REQ_NUM; request++) {
+        reset();
+        int channel = dma_channel_claim((DMARequestName)request);
+        CHECK((channel > DMA_CHANNEL_NONE) && (channel <= DMA_CHANNEL_NUM));
+        if (channel == DMA_CHANNEL_NONE)
+            continue;
+        CHECK(dma_channel_instance(channel) == &fake_dma(channel)->channel[(channel - 1) % 7]);
+        CHECK(cselr_of(channel) != 0);
+        dma_channel_release(channel);
+    }
+
+    // releasing nothing is allowed
+    dma_channel_release(DMA_CHANNEL_NONE);
+}
+
+static void test_transfer_complete(void)
+{
+    // static: the fake address registers only hold 32 bits
+    static const uint8_t message[] = "hello, usart";
+    static uint32_t tdr;
+    uint8_t tdr_log[sizeof(message)];
+
+    reset();
+    memset(tdr_log, 0, sizeof(tdr_log));
+
+    int channel = dma_channel_claim(DMA_REQ_USART2_TX);
+    CHECK(channel == 7);
+
+    // a stale flag from an earlier user is cleared when the channel is started
+    fake_dma1.regs.ISR = DMA_ISR_TEIF1 << fake_shift(channel);
+    dma_channel_start(channel, DMA_CCR_DIR | DMA_CCR_MINC | DMA_CCR_TCIE, &tdr, message, sizeof(message));
+    fake_dma_sync(&fake_dma1);
+    CHECK(dma_channel_flags(channel) == 0);
+
+    DMA_Channel_TypeDef *regs = dma_channel_instance(channel);
+    CHECK(regs->CCR == (DMA_CCR_DIR | DMA_CCR_MINC | DMA_CCR_TCIE | DMA_CCR_EN));
+    CHECK(regs->CPAR == (uint32_t)(uintptr_t)&tdr);
+    CHECK(regs->CNDTR == sizeof(message));
+    CHECK(dma_channel_remaining(channel) == sizeof(message));
+
+    fake_dma_run(channel, tdr_log);
+    CHECK(memcmp(tdr_log, message, sizeof(message)) == 0);
+    CHECK(dma_channel_remaining(channel) == 0);
+    // completion only, no half transfer or error reported
+    CHECK(dma_channel_flags(channel) == (DMA_CHANNEL_FLAG_GI | DMA_CHANNEL_FLAG_TC));
+
+    // the flags of the neighbouring channels are left alone
+    fake_dma1.regs.ISR |= DMA_ISR_TCIF1 << fake_shift(6);
+    dma_channel_clear(channel, DMA_CHANNEL_FLAG_GI | DMA_CHANNEL_FLAG_TC);
+    fake_dma_sync(&fake_dma1);
+    CHECK(dma_channel_flags(channel) == 0);
+    CHECK(dma_channel_flags(6) == DMA_CHANNEL_FLAG_TC);
+
+    // stop disables the channel and its interrupts
+    dma_channel_stop(channel);
+    CHECK(!(regs->CCR & (DMA_CCR_EN | DMA_CCR_TCIE | DMA_CCR_HTIE | DMA_CCR_TEIE)));
+    CHECK(regs->CCR & DMA_CCR_DIR);
+}
+
+int main(void)
+{
+    test_routing();
+    test_fallback();
+    test_route_table();
+    test_transfer_complete();
+
+    if (failures) {
+        printf("dma_channel_test: %d failure(s)\n", failures);
+        return 1;
+    }
+    printf("dma_channel_test: OK\n");
+    return 0;
+}
@@ -0,0 +1,272 @@
+/* mbed Microcontroller Library
+ *******************************************************************************
+ * Copyright (c) 2015, STMicroelectronics
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of STMicroelectronics nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************
+ */
+// Host stand-in for the CMSIS device header: just the DMA, USART and RCC
+// registers and core intrinsics the host tests need, backed by plain memory.
+// The USART blocks stay at their device addresses since UARTName holds them:
+// the tests map memory over FAKE_USART_START..FAKE_USART_END first.
+#ifndef MBED_CMSIS_H
+#define MBED_CMSIS_H
+
+#include <stdint.h>
+
+#define __IO volatile
+
+#define RESET 0
+#define SET   1
+
+typedef struct {
+    __IO uint32_t CCR;
+    __IO uint32_t CNDTR;
+    __IO uint32_t CPAR;
+    __IO uint32_t CMAR;
+} DMA_Channel_TypeDef;
+
+typedef struct {
+    __IO uint32_t ISR;
+    __IO uint32_t IFCR;
+} DMA_TypeDef;
+
+typedef struct {
+    __IO uint32_t CSELR;
+} DMA_Request_TypeDef;
+
+typedef struct {
+    __IO uint32_t CR1;
+    __IO uint32_t CR2;
+    __IO uint32_t CR3;
+    __IO uint32_t BRR;
+    __IO uint32_t GTPR;
+    __IO uint32_t RTOR;
+    __IO uint32_t RQR;
+    __IO uint32_t ISR;
+    __IO uint32_t ICR;
+    __IO uint32_t RDR;
+    __IO uint32_t TDR;
+} USART_TypeDef;
+
+typedef struct {
+    __IO uint32_t CCIPR;
+} RCC_TypeDef;
+
+typedef enum {
+    DMA1_Channel1_IRQn = 11,
+    DMA1_Channel2_IRQn = 12,
+    DMA1_Channel3_IRQn = 13,
+    DMA1_Channel4_IRQn = 14,
+    DMA1_Channel5_IRQn = 15,
+    DMA1_Channel6_IRQn = 16,
+    DMA1_Channel7_IRQn = 17,
+    DMA2_Channel1_IRQn = 56,
+    DMA2_Channel2_IRQn = 57,
+    DMA2_Channel3_IRQn = 58,
+    DMA2_Channel4_IRQn = 59,
+    DMA2_Channel5_IRQn = 60,
+    DMA2_Channel6_IRQn = 68,
+    DMA2_Channel7_IRQn = 69,
+    USART1_IRQn        = 37,
+    USART2_IRQn        = 38,
+    USART3_IRQn        = 39,
+    UART4_IRQn         = 52,
+    UART5_IRQn         = 53,
+    LPUART1_IRQn       = 70,
+} IRQn_Type;
+
+// Register block of the fake controllers, defined by the test
+typedef struct fake_dma {
+    DMA_TypeDef regs;
+    DMA_Channel_TypeDef channel[7];
+    DMA_Request_TypeDef cselr;
+    uint32_t clock;
+} fake_dma_t;
+
+extern fake_dma_t fake_dma1;
+extern fake_dma_t fake_dma2;
+
+#define DMA1            (&fake_dma1.regs)
+#define DMA2            (&fake_dma2.regs)
+#define DMA1_CSELR      (&fake_dma1.cselr)
+#define DMA2_CSELR      (&fake_dma2.cselr)
+#define DMA1_Channel1   (&fake_dma1.channel[0])
+#define DMA1_Channel2   (&fake_dma1.channel[1])
+#define DMA1_Channel3   (&fake_dma1.channel[2])
+#define DMA1_Channel4   (&fake_dma1.channel[3])
+#define DMA1_Channel5   (&fake_dma1.channel[4])
+#define DMA1_Channel6   (&fake_dma1.channel[5])
+#define DMA1_Channel7   (&fake_dma1.channel[6])
+#define DMA2_Channel1   (&fake_dma2.channel[0])
+#define DMA2_Channel2   (&fake_dma2.channel[1])
+#define DMA2_Channel3   (&fake_dma2.channel[2])
+#define DMA2_Channel4   (&fake_dma2.channel[3])
+#define DMA2_Channel5   (&fake_dma2.channel[4])
+#define DMA2_Channel6   (&fake_dma2.channel[5])
+#define DMA2_Channel7   (&fake_dma2.channel[6])
+
+#define USART1_BASE     (0x40013800UL)
+#define USART2_BASE     (0x40004400UL)
+#define USART3_BASE     (0x40004800UL)
+#define UART4_BASE      (0x40004C00UL)
+#define UART5_BASE      (0x40005000UL)
+#define LPUART1_BASE    (0x40008000UL)
+
+#define USART1          ((USART_TypeDef *)USART1_BASE)
+#define USART2          ((USART_TypeDef *)USART2_BASE)
+#define USART3          ((USART_TypeDef *)USART3_BASE)
+#define UART4           ((USART_TypeDef *)UART4_BASE)
+#define UART5           ((USART_TypeDef *)UART5_BASE)
+#define LPUART1         ((USART_TypeDef *)LPUART1_BASE)
+
+// Range of the USART blocks, mapped by the tests
+#define FAKE_USART_START (0x40004000UL)
+#define FAKE_USART_END   (0x40014000UL)
+
+// The kernel clock selection is the only RCC register the drivers touch directly
+extern RCC_TypeDef fake_rcc;
+
+#define RCC             (&fake_rcc)
+
+#define DMA_ISR_GIF1    (0x1U << 0)
+#define DMA_ISR_TCIF1   (0x1U << 1)
+#define DMA_ISR_HTIF1   (0x1U << 2)
+#define DMA_ISR_TEIF1   (0x1U << 3)
+#define DMA_IFCR_CGIF1  (0x1U << 0)
+
+#define DMA_CCR_EN      (0x1U << 0)
+#define DMA_CCR_TCIE    (0x1U << 1)
+#define DMA_CCR_HTIE    (0x1U << 2)
+#define DMA_CCR_TEIE    (0x1U << 3)
+#define DMA_CCR_DIR     (0x1U << 4)
+#define DMA_CCR_CIRC    (0x1U << 5)
+#define DMA_CCR_PINC    (0x1U << 6)
+#define DMA_CCR_MINC    (0x1U << 7)
+#define DMA_CCR_PSIZE_0 (0x1U << 8)
+#define DMA_CCR_MSIZE_0 (0x1U << 10)
+
+#define USART_CR1_UE        (0x1U << 0)
+#define USART_CR1_UESM      (0x1U << 1)
+#define USART_CR1_RE        (0x1U << 2)
+#define USART_CR1_TE        (0x1U << 3)
+#define USART_CR1_IDLEIE    (0x1U << 4)
+#define USART_CR1_RXNEIE    (0x1U << 5)
+#define USART_CR1_TCIE      (0x1U << 6)
+#define USART_CR1_TXEIE     (0x1U << 7)
+#define USART_CR1_PEIE      (0x1U << 8)
+#define USART_CR1_PS        (0x1U << 9)
+#define USART_CR1_PCE       (0x1U << 10)
+#define USART_CR1_WAKE      (0x1U << 11)
+#define USART_CR1_M0        (0x1U << 12)
+#define USART_CR1_MME       (0x1U << 13)
+#define USART_CR1_CMIE      (0x1U << 14)
+#define USART_CR1_OVER8     (0x1U << 15)
+#define USART_CR1_DEDT      (0x1FU << 16)
+#define USART_CR1_DEAT      (0x1FU << 21)
+#define USART_CR1_RTOIE     (0x1U << 26)
+#define USART_CR1_M1        (0x1U << 28)
+#define USART_CR1_M         (USART_CR1_M0 | USART_CR1_M1)
+
+#define USART_CR2_ADDM7     (0x1U << 4)
+#define USART_CR2_STOP      (0x3U << 12)
+#define USART_CR2_RTOEN     (0x1U << 23)
+#define USART_CR2_ADD       (0xFFU << 24)
+
+#define USART_CR3_EIE       (0x1U << 0)
+#define USART_CR3_DMAR      (0x1U << 6)
+#define USART_CR3_DMAT      (0x1U << 7)
+#define USART_CR3_RTSE      (0x1U << 8)
+#define USART_CR3_CTSE      (0x1U << 9)
+#define USART_CR3_ONEBIT    (0x1U << 11)
+#define USART_CR3_DEM       (0x1U << 14)
+#define USART_CR3_DEP       (0x1U << 15)
+#define USART_CR3_WUS       (0x3U << 20)
+#define USART_CR3_WUS_0     (0x1U << 20)
+#define USART_CR3_WUFIE     (0x1U << 22)
+
+#define USART_RTOR_RTO      (0xFFFFFFU)
+
+#define USART_RQR_SBKRQ     (0x1U << 1)
+#define USART_RQR_MMRQ      (0x1U << 2)
+#define USART_RQR_RXFRQ     (0x1U << 3)
+
+#define USART_ISR_PE        (0x1U << 0)
+#define USART_ISR_FE        (0x1U << 1)
+#define USART_ISR_NE        (0x1U << 2)
+#define USART_ISR_ORE       (0x1U << 3)
+#define USART_ISR_IDLE      (0x1U << 4)
+#define USART_ISR_RXNE      (0x1U << 5)
+#define USART_ISR_TC        (0x1U << 6)
+#define USART_ISR_TXE       (0x1U << 7)
+#define USART_ISR_RTOF      (0x1U << 11)
+#define USART_ISR_BUSY      (0x1U << 16)
+#define USART_ISR_CMF       (0x1U << 17)
+#define USART_ISR_RWU       (0x1U << 19)
+#define USART_ISR_WUF       (0x1U << 20)
+#define USART_ISR_TEACK     (0x1U << 21)
+#define USART_ISR_REACK     (0x1U << 22)
+
+#define USART_ICR_PECF      (0x1U << 0)
+#define USART_ICR_FECF      (0x1U << 1)
+#define USART_ICR_NCF       (0x1U << 2)
+#define USART_ICR_ORECF     (0x1U << 3)
+#define USART_ICR_IDLECF    (0x1U << 4)
+#define USART_ICR_TCCF      (0x1U << 6)
+#define USART_ICR_RTOCF     (0x1U << 11)
+#define USART_ICR_CMCF      (0x1U << 17)
+#define USART_ICR_WUCF      (0x1U << 20)
+
+#define __HAL_RCC_DMA1_CLK_ENABLE() (fake_dma1.clock = 1)
+#define __HAL_RCC_DMA2_CLK_ENABLE() (fake_dma2.clock = 1)
+
+// No interrupts on the host: PRIMASK is a plain variable
+extern uint32_t fake_primask;
+
+static inline uint32_t __get_PRIMASK(void)
+{
+    return fake_primask;
+}
+
+static inline void __set_PRIMASK(uint32_t primask)
+{
+    fake_primask = primask;
+}
+
+static inline void __disable_irq(void)
+{
+    fake_primask = 1;
+}
+
+static inline void __enable_irq(void)
+{
+    fake_primask = 0;
+}
+
+#define __DMB() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+#include "stm32l4xx_hal.h"
+
+#endif
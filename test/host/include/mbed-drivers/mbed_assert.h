@@ -0,0 +1,9 @@
+// Host stand-in for mbed_assert.h
+#ifndef MBED_ASSERT_H
+#define MBED_ASSERT_H
+
+#include <assert.h>
+
+#define MBED_ASSERT(expr) assert(expr)
+
+#endif
@@ -0,0 +1,231 @@
+/* mbed Microcontroller Library
+ *******************************************************************************
+ * Copyright (c) 2015, STMicroelectronics
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of STMicroelectronics nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************
+ */
+// Host stand-in for the subset of the STM32L4 HAL the serial driver uses: the
+// UART handle and register macros as in the HAL, the functions are defined by
+// the test.
+#ifndef __STM32L4xx_HAL_H
+#define __STM32L4xx_HAL_H
+
+#include <stdint.h>
+
+typedef enum {
+    HAL_OK      = 0x00,
+    HAL_ERROR   = 0x01,
+    HAL_BUSY    = 0x02,
+    HAL_TIMEOUT = 0x03,
+} HAL_StatusTypeDef;
+
+typedef enum {
+    HAL_UNLOCKED = 0x00,
+    HAL_LOCKED   = 0x01,
+} HAL_LockTypeDef;
+
+//*** GPIO ***
+
+#define GPIO_NOPULL                 (0x00000000U)
+#define GPIO_PULLUP                 (0x00000001U)
+#define GPIO_PULLDOWN               (0x00000002U)
+
+//*** UART ***
+
+typedef struct {
+    uint32_t BaudRate;
+    uint32_t WordLength;
+    uint32_t StopBits;
+    uint32_t Parity;
+    uint32_t Mode;
+    uint32_t HwFlowCtl;
+    uint32_t OverSampling;
+    uint32_t OneBitSampling;
+} UART_InitTypeDef;
+
+typedef enum {
+    HAL_UART_STATE_RESET      = 0x00,
+    HAL_UART_STATE_READY      = 0x01,
+    HAL_UART_STATE_BUSY       = 0x02,
+    HAL_UART_STATE_BUSY_TX    = 0x12,
+    HAL_UART_STATE_BUSY_RX    = 0x22,
+    HAL_UART_STATE_BUSY_TX_RX = 0x32,
+    HAL_UART_STATE_TIMEOUT    = 0x03,
+    HAL_UART_STATE_ERROR      = 0x04,
+} HAL_UART_StateTypeDef;
+
+typedef struct {
+    USART_TypeDef *Instance;
+    UART_InitTypeDef Init;
+    uint8_t *pTxBuffPtr;
+    uint16_t TxXferSize;
+    uint16_t TxXferCount;
+    uint8_t *pRxBuffPtr;
+    uint16_t RxXferSize;
+    uint16_t RxXferCount;
+    uint16_t Mask;
+    HAL_LockTypeDef Lock;
+    HAL_UART_StateTypeDef State;
+    uint32_t ErrorCode;
+} UART_HandleTypeDef;
+
+#define UART_WORDLENGTH_7B          (USART_CR1_M1)
+#define UART_WORDLENGTH_8B          (0x00000000U)
+#define UART_WORDLENGTH_9B          (USART_CR1_M0)
+
+#define UART_STOPBITS_1             (0x00000000U)
+#define UART_STOPBITS_2             (0x2U << 12)
+
+#define UART_PARITY_NONE            (0x00000000U)
+#define UART_PARITY_EVEN            (USART_CR1_PCE)
+#define UART_PARITY_ODD             (USART_CR1_PCE | USART_CR1_PS)
+
+#define UART_MODE_RX                (USART_CR1_RE)
+#define UART_MODE_TX                (USART_CR1_TE)
+#define UART_MODE_TX_RX             (USART_CR1_TE | USART_CR1_RE)
+
+#define UART_HWCONTROL_NONE         (0x00000000U)
+#define UART_HWCONTROL_RTS          (USART_CR3_RTSE)
+#define UART_HWCONTROL_CTS          (USART_CR3_CTSE)
+#define UART_HWCONTROL_RTS_CTS      (USART_CR3_RTSE | USART_CR3_CTSE)
+
+#define UART_OVERSAMPLING_16        (0x00000000U)
+#define UART_OVERSAMPLING_8         (USART_CR1_OVER8)
+
+#define UART_ONE_BIT_SAMPLE_DISABLE (0x00000000U)
+#define UART_ONE_BIT_SAMPLE_ENABLE  (USART_CR3_ONEBIT)
+
+#define UART_FLAG_RXNE              (USART_ISR_RXNE)
+#define UART_FLAG_TC                (USART_ISR_TC)
+#define UART_FLAG_TXE               (USART_ISR_TXE)
+
+// Interrupt sources: register index in bits 5..7, bit position in bits 0..4
+#define UART_IT_RXNE                (0x0525U)
+#define UART_IT_TC                  (0x0626U)
+#define UART_IT_TXE                 (0x0727U)
+#define UART_IT_MASK                (0x001FU)
+
+#define UART_CLEAR_PEF              (USART_ICR_PECF)
+#define UART_CLEAR_TCF              (USART_ICR_TCCF)
+
+#define UART_MUTE_MODE_REQUEST      (USART_RQR_MMRQ)
+
+#define UART_CR2_ADDRESS_LSB_POS      (24U)
+#define UART_CR1_DEAT_ADDRESS_LSB_POS (21U)
+#define UART_CR1_DEDT_ADDRESS_LSB_POS (16U)
+
+#define __HAL_UART_GET_FLAG(__HANDLE__, __FLAG__) (((__HANDLE__)->Instance->ISR & (__FLAG__)) == (__FLAG__))
+#define __HAL_UART_CLEAR_FLAG(__HANDLE__, __FLAG__) ((__HANDLE__)->Instance->ICR = (__FLAG__))
+#define __HAL_UART_CLEAR_PEFLAG(__HANDLE__) __HAL_UART_CLEAR_FLAG((__HANDLE__), UART_CLEAR_PEF)
+#define __HAL_UART_SEND_REQ(__HANDLE__, __REQ__) ((__HANDLE__)->Instance->RQR |= (__REQ__))
+#define __HAL_UART_ENABLE(__HANDLE__) ((__HANDLE__)->Instance->CR1 |= USART_CR1_UE)
+#define __HAL_UART_DISABLE(__HANDLE__) ((__HANDLE__)->Instance->CR1 &= ~USART_CR1_UE)
+
+#define __HAL_UART_ENABLE_IT(__HANDLE__, __IT__) \
+    ((((uint8_t)(__IT__)) >> 5U) == 1U ? ((__HANDLE__)->Instance->CR1 |= (1U << ((__IT__) & UART_IT_MASK))) : \
+     (((uint8_t)(__IT__)) >> 5U) == 2U ? ((__HANDLE__)->Instance->CR2 |= (1U << ((__IT__) & UART_IT_MASK))) : \
+                                         ((__HANDLE__)->Instance->CR3 |= (1U << ((__IT__) & UART_IT_MASK))))
+#define __HAL_UART_DISABLE_IT(__HANDLE__, __IT__) \
+    ((((uint8_t)(__IT__)) >> 5U) == 1U ? ((__HANDLE__)->Instance->CR1 &= ~(1U << ((__IT__) & UART_IT_MASK))) : \
+     (((uint8_t)(__IT__)) >> 5U) == 2U ? ((__HANDLE__)->Instance->CR2 &= ~(1U << ((__IT__) & UART_IT_MASK))) : \
+                                         ((__HANDLE__)->Instance->CR3 &= ~(1U << ((__IT__) & UART_IT_MASK))))
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart);
+HAL_StatusTypeDef HAL_UART_Transmit_IT(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_Receive_IT(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_LIN_SendBreak(UART_HandleTypeDef *huart);
+HAL_UART_StateTypeDef HAL_UART_GetState(UART_HandleTypeDef *huart);
+
+// The clocks of the fake blocks are always on
+#define __USART1_CLK_ENABLE()       do {} while (0)
+#define __USART2_CLK_ENABLE()       do {} while (0)
+#define __USART3_CLK_ENABLE()       do {} while (0)
+#define __UART4_CLK_ENABLE()        do {} while (0)
+#define __UART5_CLK_ENABLE()        do {} while (0)
+#define __LPUART1_CLK_ENABLE()      do {} while (0)
+#define __USART1_CLK_DISABLE()      do {} while (0)
+#define __USART2_CLK_DISABLE()      do {} while (0)
+#define __USART3_CLK_DISABLE()      do {} while (0)
+#define __UART4_CLK_DISABLE()       do {} while (0)
+#define __UART5_CLK_DISABLE()       do {} while (0)
+#define __LPUART1_CLK_DISABLE()     do {} while (0)
+#define __USART1_FORCE_RESET()      do {} while (0)
+#define __USART2_FORCE_RESET()      do {} while (0)
+#define __USART3_FORCE_RESET()      do {} while (0)
+#define __UART4_FORCE_RESET()       do {} while (0)
+#define __UART5_FORCE_RESET()       do {} while (0)
+#define __LPUART1_FORCE_RESET()     do {} while (0)
+#define __USART1_RELEASE_RESET()    do {} while (0)
+#define __USART2_RELEASE_RESET()    do {} while (0)
+#define __USART3_RELEASE_RESET()    do {} while (0)
+#define __UART4_RELEASE_RESET()     do {} while (0)
+#define __UART5_RELEASE_RESET()     do {} while (0)
+#define __LPUART1_RELEASE_RESET()   do {} while (0)
+
+//*** RCC ***
+
+typedef struct {
+    uint32_t PLLState;
+} RCC_PLLInitTypeDef;
+
+typedef struct {
+    uint32_t OscillatorType;
+    uint32_t HSEState;
+    uint32_t LSEState;
+    uint32_t HSIState;
+    uint32_t HSICalibrationValue;
+    uint32_t LSIState;
+    uint32_t MSIState;
+    uint32_t MSICalibrationValue;
+    uint32_t MSIClockRange;
+    RCC_PLLInitTypeDef PLL;
+} RCC_OscInitTypeDef;
+
+#define HSI_VALUE                   (16000000U)
+#define LSE_VALUE                   (32768U)
+
+#define RCC_OSCILLATORTYPE_HSI      (0x00000002U)
+#define RCC_OSCILLATORTYPE_LSE      (0x00000004U)
+#define RCC_HSI_ON                  (0x00000100U)
+#define RCC_LSE_ON                  (0x00000001U)
+#define RCC_HSICALIBRATION_DEFAULT  (16U)
+#define RCC_PLL_NONE                (0x00000000U)
+
+// The oscillators of the host are always ready
+#define RCC_FLAG_HSIRDY             (0x2AU)
+#define RCC_FLAG_LSERDY             (0x141U)
+#define __HAL_RCC_GET_FLAG(__FLAG__) (SET)
+
+#define __HAL_RCC_PWR_CLK_ENABLE()  do {} while (0)
+
+uint32_t HAL_RCC_GetSysClockFreq(void);
+uint32_t HAL_RCC_GetPCLK1Freq(void);
+uint32_t HAL_RCC_GetPCLK2Freq(void);
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef *RCC_OscInitStruct);
+
+void HAL_PWR_EnableBkUpAccess(void);
+
+#endif
@@ -0,0 +1,435 @@
+/* mbed Microcontroller Library
+ *******************************************************************************
+ * Copyright (c) 2015, STMicroelectronics
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of STMicroelectronics nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************
+ */
+// Host test of the asynchronous serial transmission against a fake USART1 and
+// fake DMA controllers. The USART registers live at their device address in an
+// anonymous mapping; the "hardware" is driven by hand: fake_sync() applies the
+// ICR/IFCR writes of the driver to the status registers and fake_dma_run()
+// feeds TDR from the channel the way the TX request would.
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "cmsis.h"
+#include "serial_api.h"
+#include "dma_channel.h"
+#include "PeripheralPins.h"
+
+fake_dma_t fake_dma1;
+fake_dma_t fake_dma2;
+RCC_TypeDef fake_rcc;
+uint32_t fake_primask;
+
+static int failures;
+
+#define CHECK(expr) do { \
+        if (!(expr)) { \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr); \
+            failures++; \
+        } \
+    } while (0)
+
+#define HANDLER ((uint32_t)0x0800BEEF)
+
+//*** target and HAL stand-ins ***
+
+const PinMap PinMap_UART_TX[] = {
+    {PA_9,  UART_1, 0},
+    {PA_2,  UART_2, 0},
+    {NC,    (int)NC, 0}
+};
+
+const PinMap PinMap_UART_RX[] = {
+    {PA_10, UART_1, 0},
+    {PA_3,  UART_2, 0},
+    {NC,    (int)NC, 0}
+};
+
+const PinMap PinMap_UART_RTS[] = {
+    {NC,    (int)NC, 0}
+};
+
+const PinMap PinMap_UART_CTS[] = {
+    {NC,    (int)NC, 0}
+};
+
+uint32_t pinmap_peripheral(PinName pin, const PinMap *map)
+{
+    for (; map->pin != NC; map++) {
+        if (map->pin == pin)
+            return (uint32_t)map->peripheral;
+    }
+    return (uint32_t)NC;
+}
+
+uint32_t pinmap_merge(uint32_t a, uint32_t b)
+{
+    if (a == (uint32_t)NC)
+        return b;
+    if (b == (uint32_t)NC || a == b)
+        return a;
+    return (uint32_t)NC;
+}
+
+void pinmap_pinout(PinName pin, const PinMap *map)
+{
+    (void)pin;
+    (void)map;
+}
+
+void pin_function(PinName pin, int function)
+{
+    (void)pin;
+    (void)function;
+}
+
+void pin_mode(PinName pin, PinMode mode)
+{
+    (void)pin;
+    (void)mode;
+}
+
+static uint32_t irq_vector[128];
+static uint8_t irq_enabled[128];
+
+void vIRQ_SetVector(IRQn_Type irqn, uint32_t vector)
+{
+    irq_vector[irqn] = vector;
+}
+
+void vIRQ_EnableIRQ(IRQn_Type irqn)
+{
+    irq_enabled[irqn] = 1;
+}
+
+void vIRQ_DisableIRQ(IRQn_Type irqn)
+{
+    irq_enabled[irqn] = 0;
+}
+
+void error(const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    exit(1);
+}
+
+uint32_t HAL_RCC_GetSysClockFreq(void)
+{
+    return 80000000;
+}
+
+uint32_t HAL_RCC_GetPCLK1Freq(void)
+{
+    return 80000000;
+}
+
+uint32_t HAL_RCC_GetPCLK2Freq(void)
+{
+    return 80000000;
+}
+
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef *RCC_OscInitStruct)
+{
+    (void)RCC_OscInitStruct;
+    return HAL_OK;
+}
+
+void HAL_PWR_EnableBkUpAccess(void)
+{
+}
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart)
+{
+    USART_TypeDef *uart = huart->Instance;
+
+    uart->CR1 = huart->Init.WordLength | huart->Init.Parity | huart->Init.Mode | huart->Init.OverSampling;
+    uart->CR2 = huart->Init.StopBits;
+    uart->CR3 = huart->Init.HwFlowCtl | huart->Init.OneBitSampling;
+    uart->BRR = HAL_RCC_GetPCLK2Freq() / huart->Init.BaudRate;
+    uart->CR1 |= USART_CR1_UE;
+    huart->State = HAL_UART_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_LIN_SendBreak(UART_HandleTypeDef *huart)
+{
+    huart->Instance->RQR |= USART_RQR_SBKRQ;
+    return HAL_OK;
+}
+
+HAL_UART_StateTypeDef HAL_UART_GetState(UART_HandleTypeDef *huart)
+{
+    return huart->State;
+}
+
+//*** fake hardware ***
+
+static void fake_usart_map(void)
+{
+    void *base = mmap((void *)FAKE_USART_START, FAKE_USART_END - FAKE_USART_START, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (base != (void *)FAKE_USART_START) {
+        perror("mmap of the USART registers");
+        exit(1);
+    }
+}
+
+// IFCR is write-only: CGIFx clears every flag of channel x, the others their own flag
+static void fake_dma_sync(fake_dma_t *dma)
+{
+    uint32_t clear = dma->regs.IFCR;
+    int shift;
+
+    for (shift = 0; shift < 28; shift += 4) {
+        if (clear & (DMA_IFCR_CGIF1 << shift)) {
+            clear |= 0xFU << shift;
+        }
+    }
+    dma->regs.ISR &= ~clear;
+    dma->regs.IFCR = 0;
+}
+
+// ICR bits clear the ISR flags at the same position
+static void fake_sync(void)
+{
+    USART1->ISR &= ~USART1->ICR;
+    USART1->ICR = 0;
+    fake_dma_sync(&fake_dma1);
+    fake_dma_sync(&fake_dma2);
+}
+
+static fake_dma_t *fake_dma(int channel)
+{
+    return (channel <= 7) ? &fake_dma1 : &fake_dma2;
+}
+
+// Move up to count items of the enabled channel into TDR, logging them
+static void fake_dma_run(int channel, uint32_t count, uint8_t *tdr_log, uint32_t length)
+{
+    DMA_Channel_TypeDef *regs = dma_channel_instance(channel);
+    const uint8_t *mem = (const uint8_t *)(uintptr_t)regs->CMAR;
+    volatile uint32_t *tdr = (volatile uint32_t *)(uintptr_t)regs->CPAR;
+
+    if (!(regs->CCR & DMA_CCR_EN))
+        return;
+    while (count-- && regs->CNDTR) {
+        uint32_t i = length - regs->CNDTR;
+        *tdr = mem[i];
+        tdr_log[i] = mem[i];
+        regs->CNDTR--;
+    }
+    if (regs->CNDTR == 0) {
+        fake_dma(channel)->regs.ISR |= (DMA_ISR_GIF1 | DMA_ISR_TCIF1) << (((channel - 1) % 7) * 4);
+    }
+}
+
+static void reset(serial_t *obj)
+{
+    int channel;
+
+    for (channel = 1; channel <= DMA_CHANNEL_NUM; channel++) {
+        dma_channel_release(channel);
+    }
+    memset(&fake_dma1, 0, sizeof(fake_dma1));
+    memset(&fake_dma2, 0, sizeof(fake_dma2));
+    memset((void *)USART1, 0, sizeof(*USART1));
+    memset(irq_vector, 0, sizeof(irq_vector));
+    memset(irq_enabled, 0, sizeof(irq_enabled));
+    memset(obj, 0, sizeof(*obj));
+
+    // reset value of ISR: the transmitter is idle
+    USART1->ISR = USART_ISR_TXE | USART_ISR_TC;
+    serial_init(obj, PA_9, PA_10);
+    fake_sync();
+}
+
+//*** tests ***
+
+static const uint8_t message[] = "hello, dma";
+
+static void test_dma_complete(void)
+{
+    static serial_t obj;
+    uint8_t tdr_log[sizeof(message)];
+
+    reset(&obj);
+    memset(tdr_log, 0, sizeof(tdr_log));
+
+    CHECK(serial_tx_asynch(&obj, (void *)message, sizeof(message), 8, HANDLER, SERIAL_EVENT_TX_COMPLETE, DMA_USAGE_OPPORTUNISTIC) == sizeof(message));
+    fake_sync();
+    CHECK(irq_vector[USART1_IRQn] == HANDLER);
+    CHECK(irq_enabled[USART1_IRQn]);
+    CHECK(serial_tx_active(&obj));
+
+    // USART1_TX on DMA1 channel 4, feeding TDR; only TC interrupts, TC cleared beforehand
+    DMA_Channel_TypeDef *channel = dma_channel_instance(4);
+    CHECK(channel->CCR & DMA_CCR_EN);
+    CHECK(channel->CCR & DMA_CCR_DIR);
+    CHECK(channel->CPAR == (uint32_t)(uintptr_t)&USART1->TDR);
+    CHECK(channel->CNDTR == sizeof(message));
+    CHECK(USART1->CR3 & USART_CR3_DMAT);
+    CHECK(USART1->CR1 & USART_CR1_TCIE);
+    CHECK(!(USART1->CR1 & USART_CR1_TXEIE));
+    CHECK(!(USART1->ISR & USART_ISR_TC));
+
+    // the channel is done, the last character leaves the shift register
+    fake_dma_run(4, sizeof(message), tdr_log, sizeof(message));
+    USART1->ISR |= USART_ISR_TC;
+    CHECK(serial_irq_handler_asynch(&obj) == SERIAL_EVENT_TX_COMPLETE);
+    fake_sync();
+    CHECK(memcmp(tdr_log, message, sizeof(message)) == 0);
+    CHECK(obj.tx_buff.pos == sizeof(message));
+    CHECK(!serial_tx_active(&obj));
+    CHECK(!(USART1->CR3 & USART_CR3_DMAT));
+    CHECK(!(USART1->CR1 & USART_CR1_TCIE));
+
+    // DMA_USAGE_OPPORTUNISTIC gives the channel back
+    CHECK(!(channel->CCR & DMA_CCR_EN));
+    CHECK(dma_channel_claim(DMA_REQ_USART1_TX) == 4);
+    dma_channel_release(4);
+
+    // DMA_USAGE_ALWAYS keeps it for the next transfer
+    CHECK(serial_tx_asynch(&obj, (void *)message, sizeof(message), 8, HANDLER, SERIAL_EVENT_TX_COMPLETE, DMA_USAGE_ALWAYS) == sizeof(message));
+    fake_sync();
+    fake_dma_run(4, sizeof(message), tdr_log, sizeof(message));
+    USART1->ISR |= USART_ISR_TC;
+    CHECK(serial_irq_handler_asynch(&obj) == SERIAL_EVENT_TX_COMPLETE);
+    fake_sync();
+    CHECK(!(channel->CCR & DMA_CCR_EN));
+    CHECK(dma_channel_claim(DMA_REQ_USART1_TX) == 13);
+    dma_channel_release(13);
+
+    serial_free(&obj);
+    CHECK(dma_channel_claim(DMA_REQ_USART1_TX) == 4);
+}
+
+static void test_dma_stalled(void)
+{
+    static serial_t obj;
+    uint8_t tdr_log[sizeof(message)];
+
+    reset(&obj);
+
+    CHECK(serial_tx_asynch(&obj, (void *)message, sizeof(message), 8, HANDLER, SERIAL_EVENT_TX_COMPLETE, DMA_USAGE_OPPORTUNISTIC) == sizeof(message));
+    fake_sync();
+
+    // the channel was held off for more than a character time: TC with items left
+    fake_dma_run(4, 5, tdr_log, sizeof(message));
+    USART1->ISR |= USART_ISR_TC;
+    CHECK(serial_irq_handler_asynch(&obj) == 0);
+    fake_sync();
+    CHECK(!(USART1->ISR & USART_ISR_TC));
+    CHECK(obj.tx_buff.pos == 5);
+    CHECK(serial_tx_active(&obj));
+    CHECK(USART1->CR3 & USART_CR3_DMAT);
+    CHECK(USART1->CR1 & USART_CR1_TCIE);
+    CHECK(dma_channel_instance(4)->CCR & DMA_CCR_EN);
+
+    // the real end
+    fake_dma_run(4, sizeof(message), tdr_log, sizeof(message));
+    USART1->ISR |= USART_ISR_TC;
+    CHECK(serial_irq_handler_asynch(&obj) == SERIAL_EVENT_TX_COMPLETE);
+    fake_sync();
+    CHECK(memcmp(tdr_log, message, sizeof(message)) == 0);
+    CHECK(obj.tx_buff.pos == sizeof(message));
+    CHECK(!serial_tx_active(&obj));
+
+    serial_free(&obj);
+}
+
+static void test_irq_fallback(void)
+{
+    static serial_t obj;
+    uint8_t tdr_log[sizeof(message)];
+    int claimed[DMA_CHANNEL_NUM];
+    int count = 0;
+    size_t i = 0;
+
+    reset(&obj);
+    memset(tdr_log, 0, sizeof(tdr_log));
+
+    // every channel USART1_TX can be routed to is taken
+    while ((claimed[count] = dma_channel_claim(DMA_REQ_USART1_TX)) != DMA_CHANNEL_NONE) {
+        count++;
+    }
+    CHECK(count == 2);
+
+    CHECK(serial_tx_asynch(&obj, (void *)message, sizeof(message), 8, HANDLER, SERIAL_EVENT_TX_COMPLETE, DMA_USAGE_ALWAYS) == sizeof(message));
+    fake_sync();
+    CHECK(!(USART1->CR3 & USART_CR3_DMAT));
+    CHECK(serial_tx_active(&obj));
+
+    // TDR was empty: the first character goes out at once, TXE paces the others
+    tdr_log[i++] = (uint8_t)USART1->TDR;
+    CHECK(USART1->CR1 & USART_CR1_TXEIE);
+    while ((USART1->CR1 & USART_CR1_TXEIE) && i < sizeof(message)) {
+        USART1->ISR = USART_ISR_TXE;
+        CHECK(serial_irq_handler_asynch(&obj) == 0);
+        fake_sync();
+        tdr_log[i++] = (uint8_t)USART1->TDR;
+    }
+    CHECK(i == sizeof(message));
+    CHECK(memcmp(tdr_log, message, sizeof(message)) == 0);
+    CHECK(!(USART1->CR1 & USART_CR1_TXEIE));
+    CHECK(USART1->CR1 & USART_CR1_TCIE);
+
+    USART1->ISR = USART_ISR_TXE | USART_ISR_TC;
+    CHECK(serial_irq_handler_asynch(&obj) == SERIAL_EVENT_TX_COMPLETE);
+    fake_sync();
+    CHECK(obj.tx_buff.pos == sizeof(message));
+    CHECK(!serial_tx_active(&obj));
+    CHECK(!(USART1->CR1 & USART_CR1_TCIE));
+
+    while (count--) {
+        dma_channel_release(claimed[count]);
+    }
+    serial_free(&obj);
+}
+
+int main(void)
+{
+    fake_usart_map();
+
+    test_dma_complete();
+    test_dma_stalled();
+    test_irq_fallback();
+
+    if (failures) {
+        printf("serial_tx_test: %d failure(s)\n", failures);
+        return 1;
+    }
+    printf("serial_tx_test: OK\n");
+    return 0;
+}
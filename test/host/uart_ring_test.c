@@ -0,0 +1,181 @@
+/* mbed Microcontroller Library
+ *******************************************************************************
+ * Copyright (c) 2015, STMicroelectronics
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of STMicroelectronics nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************
+ */
+// Host stress test of the buffered serial ring: a producer and a consumer thread
+// push a numbered byte stream through a small ring, mixing the single byte calls
+// of the interrupt side with the bulk calls of serial_read()/serial_write().
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "uart_ring.h"
+
+#define RING_SIZE   (256)
+#define STREAM_SIZE (16u * 1024u * 1024u)
+
+uint32_t fake_primask;
+
+static uart_ring_t ring;
+static uint8_t storage[RING_SIZE];
+
+// xorshift: deterministic chunk sizes, independent per thread
+static uint32_t next_random(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static uint8_t stream_byte(uint32_t position)
+{
+    return (uint8_t)((position * 2654435761u) >> 24);
+}
+
+static void *producer(void *arg)
+{
+    uint32_t state = 0x12345678;
+    uint8_t chunk[RING_SIZE + 64];
+    uint32_t sent = 0;
+
+    (void)arg;
+    while (sent < STREAM_SIZE) {
+        uint32_t random = next_random(&state);
+        if (random & 1) {
+            // interrupt style: one byte, retried while the ring is full
+            if (uart_ring_put(&ring, stream_byte(sent))) {
+                sent++;
+            } else {
+                // full: let the consumer run on a single core host
+                sched_yield();
+            }
+        } else {
+            // thread style: bulk write of whatever fits, larger than the ring at times
+            size_t length = random % sizeof(chunk);
+            if (length > STREAM_SIZE - sent) {
+                length = STREAM_SIZE - sent;
+            }
+            for (size_t i = 0; i < length; i++) {
+                chunk[i] = stream_byte(sent + i);
+            }
+            size_t written = uart_ring_write(&ring, chunk, length);
+            if (!written) {
+                sched_yield();
+            }
+            sent += written;
+        }
+    }
+    return NULL;
+}
+
+static void *consumer(void *arg)
+{
+    uint32_t state = 0x9abcdef0;
+    uint8_t chunk[RING_SIZE + 64];
+    uint32_t received = 0;
+    uint32_t *errors = (uint32_t *)arg;
+
+    while (received < STREAM_SIZE) {
+        uint32_t random = next_random(&state);
+        if (random & 1) {
+            uint8_t data;
+            if (uart_ring_get(&ring, &data)) {
+                if (data != stream_byte(received)) {
+                    (*errors)++;
+                }
+                received++;
+            } else {
+                sched_yield();
+            }
+        } else {
+            size_t length = uart_ring_read(&ring, chunk, random % sizeof(chunk));
+            if (!length) {
+                sched_yield();
+            }
+            for (size_t i = 0; i < length; i++) {
+                if (chunk[i] != stream_byte(received + i)) {
+                    (*errors)++;
+                }
+            }
+            received += length;
+        }
+    }
+    return NULL;
+}
+
+static int test_limits(void)
+{
+    uint8_t small[4];
+    uint8_t data[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    uint8_t out[8];
+    uint8_t byte;
+
+    if (uart_ring_init(&ring, small, 3) != -1)
+        return 0;
+    if (uart_ring_init(&ring, small, sizeof(small)) != 0)
+        return 0;
+    // bulk write stops at the ring size, single puts at a full ring fail
+    if ((uart_ring_write(&ring, data, sizeof(data)) != 4) || (uart_ring_space(&ring) != 0))
+        return 0;
+    if (uart_ring_put(&ring, 9))
+        return 0;
+    // wrap around: the bulk copies split in two chunks
+    if (!uart_ring_get(&ring, &byte) || (byte != 1) || !uart_ring_put(&ring, 5))
+        return 0;
+    if ((uart_ring_read(&ring, out, sizeof(out)) != 4) || (out[0] != 2) || (out[3] != 5))
+        return 0;
+    return !uart_ring_get(&ring, &byte) && (uart_ring_read(&ring, out, sizeof(out)) == 0);
+}
+
+int main(void)
+{
+    pthread_t threads[2];
+    uint32_t errors = 0;
+
+    if (!test_limits()) {
+        printf("uart_ring_test: limits failed\n");
+        return 1;
+    }
+
+    uart_ring_init(&ring, storage, sizeof(storage));
+    pthread_create(&threads[0], NULL, producer, NULL);
+    pthread_create(&threads[1], NULL, consumer, &errors);
+    pthread_join(threads[0], NULL);
+    pthread_join(threads[1], NULL);
+
+    if (errors || (ring.head != STREAM_SIZE) || (ring.tail != STREAM_SIZE)) {
+        printf("uart_ring_test: %u corrupted byte(s), head %u, tail %u\n", errors, ring.head, ring.tail);
+        return 1;
+    }
+    printf("uart_ring_test: %u bytes OK\n", STREAM_SIZE);
+    return 0;
+}